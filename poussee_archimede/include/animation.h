@@ -7,26 +7,50 @@
 class Animation
 {
 private:
-    double phi, theta; // Azimuthal and polar angles for local coordinate system orientation
+    Quaternion orient; // Orientation of the local coordinate system
     Vector acc, spd; //  Instantaneous acceleration and speed
+    Vector angSpd; // Angular speed (rad/s, world coordinates)
+    Vector inertia; // Principal moments of inertia (kg.m^2) along the local axes, 0 : no rotation around the axis
     Point pos; // Instantaneous position of the local coordinate system origin
+    Point prevPos; // Position at the previous physics step
+    Point renderPos; // Position interpolated between two physics steps for rendering
+    Quaternion prevOrient, renderOrient; // Same for the orientation
 
 public:
+    // ph, th : azimuthal (around y) and polar (around x) angles in degrees, as glRotated
     Animation(double ph = 0.0, double th = 0.0,
               Vector accel = Vector(0.0, 0.0, 0.0),
               Vector speed = Vector(0.0, 0.0, 0.0),
               Point p = Point(0.0, 0.0, 0.0)
               );
-    double getPhi() const {return phi;}
-    double getTheta() const {return theta;}
-    void setPhi(double agl) {phi = agl;}
-    void setTheta(double agl) {theta = agl;}
+    Quaternion getOrientation() const {return orient;}
+    void setOrientation(Quaternion q) {orient = q; orient.normalize();}
+    Vector getAngularSpeed() const {return angSpd;}
+    void setAngularSpeed(Vector vect) {angSpd = vect;}
+    Vector getInertia() const {return inertia;}
+    void setInertia(Vector principal) {inertia = principal;}
     Vector getAccel() const {return acc;}
     Vector getSpeed() const {return spd;}
     void setAccel(Vector vect) {acc = vect;}
     void setSpeed(Vector vect) {spd = vect;}
     Point getPos() const {return pos;}
     void setPos(Point pt) {pos = pt;}
+    Point getPrevPos() const {return prevPos;}
+    Point getRenderPos() const {return renderPos;}
+    Quaternion getRenderOrientation() const {return renderOrient;}
+    // Saves the current state as previous state, to be called before each physics step
+    void storeState() {prevPos = pos; prevOrient = orient;}
+    // Computes the rendering state between previous (alpha = 0) and current (alpha = 1) states
+    void interpolate(double alpha);
+
+    // Local (body) coordinates to world coordinates and back
+    Vector toWorld(const Vector& v) const {return orient.rotate(v);}
+    Vector toLocal(const Vector& v) const {return orient.inverseRotate(v);}
+    // Angular speed change under a torque (N.m, world coordinates) during delta_t
+    // Euler's equations in the local coordinates, with the gyroscopic term
+    void applyTorque(const Vector& torque, double delta_t);
+    // Turns the orientation at the angular speed during delta_t
+    void rotate(double delta_t) {orient.integrate(angSpd, delta_t);}
 
 };
 
@@ -0,0 +1,93 @@
+#ifndef BATCH_H_INCLUDED
+#define BATCH_H_INCLUDED
+
+#include <vector>
+#include <SDL2/SDL_opengl.h>
+#include "geometry.h"
+#include "forms.h"
+#include "bodies.h"
+#include "mesh.h"
+
+
+// Batched rendering of many spheres
+// The spheres sharing a level of detail are drawn with a single instanced call :
+// the unit sphere mesh is stored once, each instance only gives its center, radius and color
+// Without shaders or instancing, each instance is drawn with its own transform
+class SphereBatch
+{
+private:
+    // Per level of detail : x, y, z, radius, r, g, b, a of each instance
+    std::vector<GLfloat> instances[SPHERE_LOD_COUNT];
+    GLuint program; // Instancing shaders
+    GLuint instanceBuffer;
+    int status; // 0 : not initialized, 1 : instancing, -1 : fallback
+
+    bool init();
+    void drawInstanced(int lod);
+    void drawFallback(int lod);
+
+public:
+    SphereBatch();
+    ~SphereBatch();
+    SphereBatch(const SphereBatch&) = delete;
+    SphereBatch& operator=(const SphereBatch&) = delete;
+
+    // Number of instances waiting to be drawn
+    int size() const;
+    bool isInstanced() const {return status == 1;}
+
+    void clear();
+    void add(const Point& center, double radius, const Color& col, int lod);
+    // Adds a sphere form at its rendering position
+    void add(Sphere& sphere);
+    // Adds all the bodies of the store with the same color
+    // lods keeps the level of each body between frames, for the hysteresis
+    void add(const BodyStore& bodies, const Color& col, std::vector<int>& lods);
+
+    // Draws and clears the instances, to be called with the camera model view matrix
+    void draw();
+};
+
+
+// Batched rendering of the cube faces
+// The faces never change shape : they are gathered once in a static vertex buffer
+// All the opaque faces are drawn with one call, then all the transparent faces
+// with one call, sorted from back to front, blending being enabled only once
+class FaceBatch
+{
+private:
+    std::vector<GLfloat> vertices; // x, y, z then r, g, b, a of each vertex
+    std::vector<GLuint> opaqueIndices;
+    std::vector<GLuint> transparentIndices; // Reordered when the camera moves
+    std::vector<Point> transparentCenters; // Center of each transparent face
+    std::vector<GLuint> indices; // Opaque then transparent indices, as uploaded
+    GLuint vertexBuffer, indexBuffer;
+    int faceCount;
+    bool uploaded;
+    bool sorted;
+    Point sortEye; // Camera position of the last transparent faces sort
+
+    void upload();
+    void uploadIndices();
+    void sortTransparent(const Point& eye);
+    void drawRange(int first, int count);
+
+public:
+    FaceBatch();
+    ~FaceBatch();
+    FaceBatch(const FaceBatch&) = delete;
+    FaceBatch& operator=(const FaceBatch&) = delete;
+
+    int size() const {return faceCount;}
+    bool isEmpty() const {return faceCount == 0;}
+    // Forgets the faces, to be done if a face is moved
+    void clear();
+    void add(const Cube_face& face);
+
+    // Draws the opaque faces
+    void drawOpaque();
+    // Draws the transparent faces seen from the eye (world coordinates), to be done last
+    void drawTransparent(const Point& eye);
+};
+
+#endif // BATCH_H_INCLUDED
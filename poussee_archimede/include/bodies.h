@@ -0,0 +1,57 @@
+#ifndef BODIES_H_INCLUDED
+#define BODIES_H_INCLUDED
+
+#include <vector>
+#include "geometry.h"
+#include "kernel.h"
+#include "thread_pool.h"
+#include "spatial_sort.h"
+
+
+// Batched store of floating spheres
+// Each physical field is kept in its own contiguous array (structure of arrays)
+// so that the whole set is stepped in one tight loop, without virtual calls
+class BodyStore
+{
+private:
+    std::vector<double> px, py, pz; // Center positions
+    std::vector<double> vx, vy, vz; // Speeds
+    std::vector<double> wx, wy, wz; // Angular speeds
+    std::vector<double> radius;
+    std::vector<double> density;
+    std::vector<double> volume; // Cached from radius
+    std::vector<double> mass; // Cached from radius and density
+    std::vector<double> invMass; // 1 / mass, the kernel only multiplies
+    std::vector<double> invInertia; // 1 / moment of inertia, cached from mass and radius
+
+public:
+    int size() const {return (int)px.size();}
+    void reserve(int n);
+    void clear();
+    // Adds a sphere, returns its index in the store
+    int add(Point pos, Vector speed, double r, double dens, Vector angularSpeed = Vector(0, 0, 0));
+
+    Point getPos(int i) const {return Point(px[i], py[i], pz[i]);}
+    Vector getSpeed(int i) const {return Vector(vx[i], vy[i], vz[i]);}
+    void setPos(int i, Point pt) {px[i] = pt.x; py[i] = pt.y; pz[i] = pt.z;}
+    void setSpeed(int i, Vector v) {vx[i] = v.x; vy[i] = v.y; vz[i] = v.z;}
+    Vector getAngularSpeed(int i) const {return Vector(wx[i], wy[i], wz[i]);}
+    void setAngularSpeed(int i, Vector w) {wx[i] = w.x; wy[i] = w.y; wz[i] = w.z;}
+    double getRadius(int i) const {return radius[i];}
+    double getDensity(int i) const {return density[i];}
+    double getVolume(int i) const {return volume[i];}
+    double getMass(int i) const {return mass[i];}
+
+    // Pointers on the arrays, valid until the next body is added
+    BodyArrays getArrays();
+    // Puts the bodies in the order of the sort, the body i becomes the body sort.getRank()[i]
+    void reorder(const SpatialSort& sort);
+
+    // Advances all the bodies with the same buoyancy model as the spheres, semi-implicit Euler
+    // The vectorized kernel is selected according to the CPU
+    void step(double delta_t);
+    // Same, the bodies are shared between the threads of the pool
+    void step(double delta_t, ThreadPool& pool);
+};
+
+#endif // BODIES_H_INCLUDED
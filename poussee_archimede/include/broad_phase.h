@@ -0,0 +1,132 @@
+#ifndef BROAD_PHASE_H_INCLUDED
+#define BROAD_PHASE_H_INCLUDED
+
+#include <vector>
+#include "kernel.h"
+#include "thread_pool.h"
+
+
+// Bodies (or pairs) of a chunk of the parallel collision loops
+const int COLLISION_GRAIN = 1024;
+
+// Spread along the current axis of the sweep below which a wider axis is taken, sorted again from scratch
+const double SWEEP_AXIS_SWITCH = 0.5;
+
+
+// Bodies whose bounding boxes overlap, a < b
+class BodyPair
+{
+public:
+    int a, b;
+    BodyPair(int i = 0, int j = 0) {a = i; b = j;}
+};
+
+
+// Broad phase algorithms
+enum BroadPhaseType {BROADPHASE_GRID, BROADPHASE_SWEEP};
+
+
+// Finds the pairs of spheres whose bounding boxes overlap
+// The bodies are first ordered by build, then searched by ranges of this order,
+// so that the ranges can be shared between threads
+class BroadPhase
+{
+public:
+    virtual ~BroadPhase() {}
+    virtual BroadPhaseType getType() const = 0;
+
+    virtual void build(const BodyArrays& bodies) = 0;
+    // Same, the per body work is done by the threads of the pool
+    virtual void build(const BodyArrays& bodies, ThreadPool& pool) = 0;
+
+    // Number of ordered bodies, the ranges of findPairs are within [0, size()[
+    virtual int size() const = 0;
+    // Appends the pairs of the ordered bodies [begin, end[, each pair found once
+    virtual void findPairs(int begin, int end, std::vector<BodyPair>& pairs) const = 0;
+
+    // The bodies were renumbered, the body i is now rank[i] (-1 : removed)
+    virtual void renumber(const std::vector<int>&) {}
+};
+
+
+// Uniform grid of cubic cells, hashed in a table
+// Rebuilt at each step with a counting sort of the bodies by cell
+// Fast as long as the radii are close : the cells are sized on the largest one
+class SpatialGrid : public BroadPhase
+{
+private:
+    double cellSize; // Twice the largest radius : a body only meets the bodies of the 27 cells around its own
+    int tableMask; // Table size - 1, a power of 2
+    std::vector<int> cellX, cellY, cellZ; // Cell of each body
+    std::vector<int> bucket; // Table entry of each body
+    std::vector<int> bucketStart; // First sorted body of each entry, one more entry at the end
+    std::vector<int> sorted; // Bodies sorted by entry, in index order in each entry
+    // Cells and spheres of the sorted bodies, read contiguously by the searches
+    std::vector<int> sortedX, sortedY, sortedZ;
+    std::vector<double> sortedPx, sortedPy, sortedPz, sortedRadius;
+
+    int hash(int x, int y, int z) const;
+    // Cell size and arrays for the given bodies
+    void resize(const BodyArrays& bodies);
+    void computeCells(const BodyArrays& bodies, int begin, int end);
+    void sortBodies(const BodyArrays& bodies);
+
+public:
+    SpatialGrid() {cellSize = 0.0; tableMask = 0;}
+    BroadPhaseType getType() const {return BROADPHASE_GRID;}
+    double getCellSize() const {return cellSize;}
+
+    void build(const BodyArrays& bodies);
+    void build(const BodyArrays& bodies, ThreadPool& pool);
+
+    int size() const {return (int)sorted.size();}
+    // Pairs with the bodies of the own cell and of half of the cells around (13 out of 26)
+    void findPairs(int begin, int end, std::vector<BodyPair>& pairs) const;
+};
+
+
+// Sweep and prune along one axis : the bodies are sorted by the lower bound of their box,
+// a body only meets the following ones until their lower bound passes its upper bound
+// The order is kept from one step to the next and updated with an insertion sort,
+// close to linear as the bodies hardly move between two steps
+// Any mix of radii, a large sphere only costs the bodies along its own extent
+class SweepAndPrune : public BroadPhase
+{
+private:
+    int axis; // 0, 1, 2 : x, y, z, the one along which the bodies are the most spread
+    std::vector<int> sorted; // Bodies by increasing lower bound, kept between the builds
+    std::vector<double> lower, upper; // Bounds along the axis of the sorted bodies
+    // Spheres of the sorted bodies, read contiguously by the searches
+    std::vector<double> sortedPx, sortedPy, sortedPz, sortedRadius;
+    long swaps; // Moves of the insertion sort at the last build
+
+    // Keeps the axis or takes a wider one, true if the order must be rebuilt
+    bool chooseAxis(const BodyArrays& bodies);
+    void computeBounds(const BodyArrays& bodies, int begin, int end);
+    // Insertion sort of the order of the last build, or full sort if it is lost
+    void sortBodies(bool fresh);
+    void copyBodies(const BodyArrays& bodies, int begin, int end);
+
+public:
+    SweepAndPrune() {axis = 0; swaps = 0;}
+    BroadPhaseType getType() const {return BROADPHASE_SWEEP;}
+    int getAxis() const {return axis;}
+    long getSwaps() const {return swaps;}
+
+    void build(const BodyArrays& bodies);
+    void build(const BodyArrays& bodies, ThreadPool& pool);
+
+    int size() const {return (int)sorted.size();}
+    void findPairs(int begin, int end, std::vector<BodyPair>& pairs) const;
+
+    // The order is kept for the next build
+    void renumber(const std::vector<int>& rank);
+};
+
+
+// New broad phase of the given type, to be deleted by the caller
+BroadPhase* create_broad_phase(BroadPhaseType type);
+
+const char* broad_phase_name(BroadPhaseType type);
+
+#endif // BROAD_PHASE_H_INCLUDED
@@ -0,0 +1,95 @@
+#ifndef BSPLINE_H_INCLUDED
+#define BSPLINE_H_INCLUDED
+
+#include <vector>
+#include "geometry.h"
+#include "thread_pool.h"
+
+
+// Highest order (degree + 1) handled by the evaluator
+const int BSPLINE_MAX_ORDER = 32;
+
+
+// Samples of a surface on a regular grid of parameters
+// Sample (i, j) : i along u, j along v, stored at j * countU + i
+class SurfaceGrid
+{
+public:
+    int countU, countV;
+    std::vector<double> x, y, z; // Positions
+    std::vector<double> nx, ny, nz; // Unit normals
+    SurfaceGrid() {countU = 0; countV = 0;}
+    int size() const {return countU * countV;}
+    int index(int i, int j) const {return j * countU + i;}
+    void resize(int cu, int cv);
+};
+
+
+// Tensor product B-spline surface, evaluated on the CPU
+// Control point (i, j) : i along u, j along v, coordinates stored at (j * countU + i) * 3
+// In each direction, order = number of knots - number of control points
+// The normal is dS/dv ^ dS/du : +y for a net laid on the xz plane with u along x and v along z
+class BSplineSurface
+{
+private:
+    int countU, countV; // Control points in each direction
+    int orderU, orderV;
+    std::vector<double> knotsU, knotsV;
+    std::vector<double> points; // x, y, z of each control point
+
+    // Basis functions of a direction, for a batch of parameters
+    class Basis
+    {
+    public:
+        int order, count; // count parameters
+        std::vector<int> first; // First control point of each parameter
+        std::vector<double> values, derivatives; // order arrays of count weights (k * count + s)
+    };
+    void computeBasis(const std::vector<double>& knots, int nbPoints, int order,
+                      const std::vector<double>& params, Basis& basis) const;
+    void evaluateRows(const Basis& basisU, const Basis& basisV, int begin, int end, SurfaceGrid& grid) const;
+
+public:
+    BSplineSurface();
+    // Returns false if the sizes are not consistent or the order too high
+    bool set(const float *ctrlPoints, int nbPointsU, int nbPointsV,
+             const float *nodesU, int nbNodesU, const float *nodesV, int nbNodesV);
+    // Same sizes, new positions of the control points
+    void setPoints(const float *ctrlPoints);
+    bool isEmpty() const {return points.empty();}
+    int getCountU() const {return countU;}
+    int getCountV() const {return countV;}
+
+    // Domain of the parameters
+    double getMinU() const {return knotsU[orderU - 1];}
+    double getMaxU() const {return knotsU[countU];}
+    double getMinV() const {return knotsV[orderV - 1];}
+    double getMaxV() const {return knotsV[countV];}
+
+    // Knot span [knots[span], knots[span + 1][ holding t, clamped to the domain
+    static int findSpan(const std::vector<double>& knots, int nbPoints, int order, double t);
+
+    // One point by de Boor's algorithm
+    Point evaluate(double u, double v) const;
+    // Same with the unit normal
+    Point evaluate(double u, double v, Vector& normal) const;
+
+    // countU x countV points spread evenly over the whole domain, with their normals
+    // The basis functions are computed once per row and per column, then the rows
+    // are accumulated on contiguous samples with the vector instructions
+    void evaluateGrid(int nbSamplesU, int nbSamplesV, SurfaceGrid& grid) const;
+    // Same, rows spread over the threads
+    void evaluateGrid(int nbSamplesU, int nbSamplesV, SurfaceGrid& grid, ThreadPool& pool) const;
+};
+
+
+// Kernels of the grid evaluation, selected with get_kernel_level()
+// out[s] += w[s] * a for the three coordinates, s in [0, n[
+void bspline_accumulate(const double *w, double ax, double ay, double az,
+                        double *outx, double *outy, double *outz, int n);
+// n = (v ^ u) / |v ^ u|, (0, 0, 0) where the vectors are parallel
+void bspline_normals(const double *ux, const double *uy, const double *uz,
+                     const double *vx, const double *vy, const double *vz,
+                     double *nx, double *ny, double *nz, int n);
+
+#endif // BSPLINE_H_INCLUDED
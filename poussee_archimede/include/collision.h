@@ -0,0 +1,146 @@
+#ifndef COLLISION_H_INCLUDED
+#define COLLISION_H_INCLUDED
+
+#include <vector>
+#include "geometry.h"
+#include "kernel.h"
+#include "thread_pool.h"
+#include "broad_phase.h"
+
+
+// Part of the normal speed kept after a contact between bodies (0 : no bounce)
+const double CONTACT_RESTITUTION = 0.3;
+
+// Coulomb friction coefficient between bodies : tangential impulse up to this part of the normal one
+const double CONTACT_FRICTION = 0.3;
+
+// Same for the contacts with the walls, unless given
+const double WALL_RESTITUTION = 0.2;
+const double WALL_FRICTION = 0.5;
+
+// Approaching speed under which a new contact doesn't bounce (m/s)
+// Above what gravity adds in a step, resting bodies stay at rest
+const double RESTITUTION_THRESHOLD = 0.5;
+
+// Part of the overlap removed at each step, the rest at the next ones
+const double CONTACT_CORRECTION = 0.8;
+
+// Passes of the contact solver over all the contacts at each step
+const int CONTACT_ITERATIONS = 4;
+
+
+// Static rectangle, org + s u + t v for s in [0, length] and t in [0, width]
+// The bodies stay on the side of the normal, a body whose center went behind
+// by less than its radius is pushed back : thin walls are not crossed in one step
+class Wall
+{
+public:
+    Point org;
+    Vector u, v; // Unit sides
+    double length, width;
+    Vector normal; // Unit, towards the bodies
+    double restitution, friction;
+    // The normal is taken on the side of the inside point
+    Wall(Point o, Vector v1, Vector v2, double l, double w, Point inside,
+         double rest = WALL_RESTITUTION, double fric = WALL_FRICTION);
+    // Signed distance of a point to the plane of the wall, > 0 on the side of the normal
+    double distance(const Point& p) const {return Vector(org, p) * normal;}
+};
+
+
+// Contact of body a with body b, or with the wall -1 - b when b < 0
+class Contact
+{
+public:
+    int a, b;
+    Vector normal; // Unit, from b towards a
+    double depth; // Overlap along the normal, > 0
+    double restitution, friction;
+    // Solver state, the impulses are kept for the same contact at the next step
+    double normalImpulse; // Accumulated over the iterations, >= 0
+    Vector tangentImpulse; // Accumulated friction, in the contact plane
+    double approach; // Normal speed before the impulses, < 0 when the bodies get closer
+    double target; // Separating speed to reach, from the restitution
+    bool persistent; // Already there at the previous step : only new contacts bounce
+    Contact() {a = b = 0; depth = restitution = friction = 0.0; normalImpulse = approach = target = 0.0; persistent = false;}
+};
+
+
+// Finds the contacts of a set of spheres, between them and with static walls,
+// and pushes the bodies apart
+class CollisionSystem
+{
+private:
+    std::vector<Wall> walls;
+    BroadPhase *broadPhase; // Owned
+    std::vector<BodyPair> pairs;
+    std::vector<Contact> contacts;
+    int pairContacts; // Contacts between bodies, first in contacts, the wall ones follow
+    // Contacts of the previous step, their impulses start the solver (warm starting)
+    std::vector<Contact> cache;
+    int cachePairContacts;
+    int iterations;
+    bool warmStarting;
+    // Moves and removals of bodies since the last step, applied to its contacts at the next one
+    // rank : new number of each body of the last step (-1 : removed), origin : body of the last step
+    // now at each number (-1 : none), both the identity again once applied
+    std::vector<int> rank, origin;
+    std::vector<int> touched; // Entries of rank and origin to set back
+
+    // Contacts of the pairs [begin, end[, then of the bodies [begin, end[ with the walls
+    void collidePairs(const BodyArrays& bodies, int begin, int end, std::vector<Contact>& found) const;
+    void collideWalls(const BodyArrays& bodies, int begin, int end, std::vector<Contact>& found) const;
+    // Orders the pairs by bodies, the contacts then come in the same order at each step
+    void sortPairs(int count);
+    // Contacts of the last step and broad phase renumbered, the body i is now rank[i]
+    void renumber(const std::vector<int>& rank);
+    // Applies the moves and removals since the last step
+    void applyRenumbering();
+    // rank and origin over the bodies of this step
+    void resetNumbering(int count);
+    // Finds the contacts of the previous step, their impulses start the solver
+    void warmStart();
+    // Projected Gauss-Seidel : normal and friction impulses, contact by contact, several passes,
+    // then overlap correction ; the friction also turns the spheres
+    void solve(BodyArrays& bodies);
+
+public:
+    CollisionSystem(BroadPhaseType type = BROADPHASE_GRID);
+    ~CollisionSystem() {delete broadPhase;}
+    CollisionSystem(const CollisionSystem&) = delete;
+    CollisionSystem& operator=(const CollisionSystem&) = delete;
+
+    BroadPhase& getBroadPhase() {return *broadPhase;}
+    // Replaces the broad phase, the next step starts from scratch
+    void setBroadPhase(BroadPhaseType type);
+
+    void addWall(const Wall& wall) {walls.push_back(wall);}
+    void clearWalls() {walls.clear();}
+    int getWallCount() const {return (int)walls.size();}
+    const Wall& getWall(int i) const {return walls[i];}
+    // Contacts found at the last step, numbered as then even after moveBody or dropBody
+    const std::vector<Contact>& getContacts() const {return contacts;}
+    int getPairCount() const {return (int)pairs.size();}
+    int getIterations() const {return iterations;}
+    void setIterations(int n) {iterations = n;}
+    // Without warm starting the solver starts from zero impulses at each step
+    bool isWarmStarting() const {return warmStarting;}
+    void setWarmStarting(bool w) {warmStarting = w;}
+
+    // The bodies were renumbered (reordered in memory), the body i is now rank[i] :
+    // the contacts of the last step are renumbered for the warm starting
+    // A rank of -1 : the body was removed, its contacts are dropped
+    void renumberBodies(const std::vector<int>& rank);
+    // Same for a single body, O(1) : the body from now has the number to (swap remove of a store),
+    // or the body i was removed ; the contacts follow at the next step
+    void moveBody(int from, int to);
+    void dropBody(int i);
+
+    // Finds the contacts and updates the speeds and positions of the bodies
+    void step(BodyArrays& bodies);
+    // Same, the contacts are found by the threads of the pool
+    // The contacts are listed in the same order whatever the threads
+    void step(BodyArrays& bodies, ThreadPool& pool);
+};
+
+#endif // COLLISION_H_INCLUDED
@@ -0,0 +1,156 @@
+#ifndef FORM_POOL_H_INCLUDED
+#define FORM_POOL_H_INCLUDED
+
+#include <vector>
+#include <utility>
+#include <new>
+#include "forms.h"
+
+
+// Forms allocated at once by a pool when it needs room
+const int FORM_POOL_BLOCK = 64;
+
+
+// Pool of forms of one class : blocks of objects, the freed ones are reused
+// The memory is only given back when the pool is destroyed
+template <class T>
+class FormPool
+{
+private:
+    std::vector<T*> blocks; // Raw storage of FORM_POOL_BLOCK objects each
+    int used; // Objects of the last block never used yet
+    std::vector<T*> freed; // Destroyed objects, their room is taken first
+
+public:
+    FormPool() {used = FORM_POOL_BLOCK;}
+    ~FormPool()
+    {
+        for (size_t b = 0; b < blocks.size(); b++)
+        {
+            ::operator delete(blocks[b]);
+        }
+    }
+    FormPool(const FormPool&) = delete;
+    FormPool& operator=(const FormPool&) = delete;
+
+    // Builds an object with the given constructor arguments
+    template <class... Args>
+    T* create(Args&&... args)
+    {
+        T* room;
+        if (!freed.empty())
+        {
+            room = freed.back();
+            freed.pop_back();
+        }
+        else
+        {
+            if (used == FORM_POOL_BLOCK)
+            {
+                blocks.push_back(static_cast<T*>(::operator new(FORM_POOL_BLOCK * sizeof(T))));
+                used = 0;
+            }
+            room = blocks.back() + used++;
+        }
+        return new (room) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* object)
+    {
+        object->~T();
+        freed.push_back(object);
+    }
+
+    int getBlockCount() const {return (int)blocks.size();}
+};
+
+
+// Classes of forms, one pool each
+enum FormType {FORM_SPHERE, FORM_CUBE_FACE, FORM_SURFACE, FORM_FLUID};
+
+
+// Form of an arena : slot and generation of the slot
+// A handle on a destroyed form is stale, the arena then gives NULL for it
+class FormHandle
+{
+public:
+    int index; // -1 : no form
+    unsigned int generation;
+    FormHandle(int i = -1, unsigned int g = 0) {index = i; generation = g;}
+    bool isNull() const {return index < 0;}
+};
+
+
+// Owner of the forms of a scene, one pool per class
+// All the forms are destroyed at once by clear, the pools keep their memory for the next scene
+class FormArena
+{
+private:
+    class Slot
+    {
+    public:
+        Form *form; // NULL when free
+        FormType type;
+        unsigned int generation; // Increased when the form is destroyed
+    };
+    std::vector<Slot> slots;
+    std::vector<int> freeSlots;
+    int count;
+
+    FormPool<Sphere> spheres;
+    FormPool<Cube_face> faces;
+    FormPool<Surface> surfaces;
+    FormPool<Fluid> fluids;
+
+    FormPool<Sphere>& getPool(Sphere*) {return spheres;}
+    FormPool<Cube_face>& getPool(Cube_face*) {return faces;}
+    FormPool<Surface>& getPool(Surface*) {return surfaces;}
+    FormPool<Fluid>& getPool(Fluid*) {return fluids;}
+    static FormType getType(Sphere*) {return FORM_SPHERE;}
+    static FormType getType(Cube_face*) {return FORM_CUBE_FACE;}
+    static FormType getType(Surface*) {return FORM_SURFACE;}
+    static FormType getType(Fluid*) {return FORM_FLUID;}
+
+    FormHandle addSlot(Form *form, FormType type);
+    void destroyForm(Slot& slot);
+
+public:
+    FormArena() {count = 0;}
+    ~FormArena() {clear();}
+    FormArena(const FormArena&) = delete;
+    FormArena& operator=(const FormArena&) = delete;
+
+    // Builds a form of class T (Sphere, Cube_face, Surface or Fluid) with the given constructor arguments
+    template <class T, class... Args>
+    FormHandle create(Args&&... args)
+    {
+        T* form = getPool((T*)NULL).create(std::forward<Args>(args)...);
+        return addSlot(form, getType((T*)NULL));
+    }
+
+    // Form of the handle, NULL if it was destroyed
+    Form* get(FormHandle handle) const
+    {
+        if (handle.index < 0 || handle.index >= (int)slots.size() || slots[handle.index].generation != handle.generation)
+        {
+            return NULL;
+        }
+        return slots[handle.index].form;
+    }
+    // Same, NULL if the form isn't of class T
+    template <class T>
+    T* get(FormHandle handle) const
+    {
+        Form* form = get(handle);
+        return form != NULL && slots[handle.index].type == getType((T*)NULL) ? static_cast<T*>(form) : NULL;
+    }
+    FormType getType(FormHandle handle) const {return slots[handle.index].type;}
+
+    // The handles on the form become stale
+    void destroy(FormHandle handle);
+    // Destroys all the forms
+    void clear();
+    int size() const {return count;}
+};
+
+#endif // FORM_POOL_H_INCLUDED
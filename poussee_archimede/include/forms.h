@@ -1,7 +1,13 @@
 #ifndef FORMS_H_INCLUDED
 #define FORMS_H_INCLUDED
+#include <SDL2/SDL_opengl.h>
 #include "geometry.h"
 #include "animation.h"
+#include "bspline.h"
+#include "mesh.h"
+#include "waves.h"
+#include "integrator.h"
+#include "sph.h"
 
 
 
@@ -39,25 +45,64 @@ protected:
     Animation anim;
 public:
     Animation& getAnim() {return anim;}
+    Color getColor() const {return col;}
     void setAnim(Animation ani) {anim = ani;}
+    virtual ~Form() {}
     // This method should update the anim object with the corresponding physical model
     // It has to be done in each inherited class, otherwise all forms will have the same movements !
     // Virtual method for dynamic function call
     // Pure virtual to ensure all objects have their physics implemented
     virtual void update(double delta_t) = 0;
-    // Virtual method : Form is a generic type, only setting color and reference position
-    virtual void render();
+    // Form is a generic type, only setting color and reference position
+    // Not virtual : the forms are drawn by concrete type, and the rendering
+    // (forms_render.cpp) is only built with the OpenGL targets
+    void render();
+};
+
+
+// Weight, buoyancy and drag of a sphere in water at a given level
+class SphereForces : public ForceModel
+{
+private:
+    double radius, volume, invMass;
+    double waterLevel;
+public:
+    SphereForces(double r, double vol, double mass, double level);
+    Vector acceleration(const Point& pos, const Vector& spd) const;
+    // Torque of the buoyancy about the center (N.m), applied at the center of buoyancy
+    // Both are on the vertical of the center : none for a sphere, which floats in any orientation
+    Vector torque(const Point& pos) const;
+};
+
+
+// Weight and force of the fluid particles on a sphere, the fluid force is the mean over the step
+class FluidForces : public ForceModel
+{
+private:
+    Vector fluid; // Acceleration given by the fluid
+public:
+    FluidForces(const Vector& force, double mass);
+    Vector acceleration(const Point& pos, const Vector& spd) const;
 };
 
 
 // A particular Form
-class Sphere : public Form {
+class Sphere final : public Form {
     private:
         // The sphere center is aligned with the coordinate system origin
         // => no center requirepd here, information is stored in the anim object
         double radius; //radius = rayon
+        int lod; // Level of detail of the last rendering, -1 before
+        WaveField *waves; // NULL : still water at WATER_LEVEL
+        double displaced; // Submerged volume pushed into the waves
+        Integrator *integrator; // Owned by the sphere
+        SphFluid *fluid; // NULL : water of the waves model
+        int fluidBody; // Index of the sphere among the bodies of the fluid
     public:
         Sphere(double r = 1.0, Color cl = Color());
+        ~Sphere();
+        Sphere(const Sphere&) = delete;
+        Sphere& operator=(const Sphere&) = delete;
         double getRadius() const {return radius;}
         void setRadius(double r) {radius = r;}
         void update(double delta_t);
@@ -65,27 +110,77 @@ class Sphere : public Form {
         double getDensity();
         double getMass();
         void render();
+        // Center of the rendered sphere
+        Point getRenderCenter() const;
+        // Chooses the level of detail from the size on screen
+        int updateLod();
         void rotate() ;
         void translation(int x) ;
         void setWater(double width, double height, double depth, double density);
+        // The sphere floats on the waves and makes waves when moving in the water
+        void setWaves(WaveField *w) {waves = w;}
+        WaveField* getWaves() {return waves;}
+        // Integration scheme of the motion, semi-implicit Euler by default
+        Integrator& getIntegrator() {return *integrator;}
+        void setIntegrator(IntegratorType type);
+        // The sphere moves in the fluid particles instead of the water level, as its body of the given index
+        void setFluid(SphFluid *f, int body) {fluid = f; fluidBody = body;}
+        SphFluid* getFluid() {return fluid;}
+        int getFluidBody() const {return fluidBody;}
 };
 
 
 // A face of a cube
-class Cube_face : public Form
+class Cube_face final : public Form
 {
 private:
     Vector vdir1, vdir2;
     double length, width;
+    bool solid; // The spheres bounce on it, false for the water faces
 public:
     Cube_face(Vector v1 = Vector(1,0,0), Vector v2 = Vector(0,0,1),
           Point org = Point(), double l = 1.0, double w = 1.0,
           Color cl = Color());
-    void update(double delta_t);
+    Vector getVdir1() const {return vdir1;}
+    Vector getVdir2() const {return vdir2;}
+    double getLength() const {return length;}
+    double getWidth() const {return width;}
+    bool isSolid() const {return solid;}
+    void setSolid(bool s) {solid = s;}
+    // Corners in world coordinates, in rendering order
+    void getCorners(Point corners[4]) const;
+    // Faces with some transparency are blended
+    bool isTransparent() const {return col.t < 1.0f;}
+    // Faces of the tank don't move
+    void update(double) {}
     void render();
 };
 
-class Surface : public Form
+// Water simulated by particles, drawn as points
+// Advanced by the scene before the forms, like the waves
+class Fluid final : public Form
+{
+private:
+    SphFluid *fluid; // Owned
+    std::vector<GLfloat> vertices; // Coordinates of the particles, filled at each rendering
+public:
+    // Takes the ownership of the particles
+    Fluid(SphFluid *f, Color cl = Color());
+    ~Fluid() {delete fluid;}
+    Fluid(const Fluid&) = delete;
+    Fluid& operator=(const Fluid&) = delete;
+    SphFluid& getFluid() {return *fluid;}
+    // Nothing to do here, the particles are advanced by the scene before the forms
+    void update(double) {}
+    // Particles at the last physics step : sorted again at each sub step, they can't be interpolated
+    void render();
+};
+
+
+// Samples of the surface tessellation in each direction
+const int SURFACE_SAMPLES = 17;
+
+class Surface final : public Form
 {
 private:
     GLfloat *ctrlPoints;
@@ -95,8 +190,35 @@ private:
     int nbNoeudsX;
     GLfloat *NoeudsZ;
     int nbNoeudsZ;
+    // B-spline of the control points, u along X and v along Z
+    BSplineSurface shape;
+    // Tessellation cache, built at first rendering
+    SurfaceGrid grid;
+    Mesh mesh;
+    // Simulated water the surface follows, owned by the surface, NULL if static
+    WaveField *waves;
+    bool tessellated; // false when the control points changed since the last tessellation
+    void tessellate();
 public:
-    Surface(GLfloat *ctrlPoints, int nbPointsX, int nbPointsZ);
+    // Control point (i, j) : i along X, j along Z, coordinates at (j * nbPointsX + i) * 3
+    // order 0 : as many as control points, the surface is a single Bezier patch
+    Surface(GLfloat *ctrlPoints, int nbPointsX, int nbPointsZ, Color cl = Color(), int order = 0);
+    ~Surface();
+    Surface(const Surface&) = delete;
+    Surface& operator=(const Surface&) = delete;
+    int getNbPointsX() const {return nbPointsX;}
+    int getNbPointsZ() const {return nbPointsZ;}
+    const GLfloat* getCtrlPoints() const {return ctrlPoints;}
+    const BSplineSurface& getShape() const {return shape;}
+    WaveField* getWaves() {return waves;}
+    // The control points heights follow the waves at each update, the surface deletes them
+    void setWaves(WaveField *w);
+    // Copies nbPointsX * nbPointsZ * 3 coordinates, the surface is tessellated again at next rendering
+    void setCtrlPoints(const GLfloat *points);
+    // Height of the surface above (x, z) in world coordinates
+    // The parameters are taken proportional to x and z, which is exact for a net
+    // evenly spaced in x and z (the B-spline then keeps x and z linear)
+    double getHeight(double x, double z);
     void update(double delta_t);
     void render();
 };
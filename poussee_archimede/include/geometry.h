@@ -41,6 +41,29 @@ public:
 };
 
 
+// Rotation stored as a unit quaternion w + x i + y j + z k
+class Quaternion
+{
+public:
+    double w, x, y, z;
+    // Identity by default
+    Quaternion(double ww=1, double xx=0, double yy=0, double zz=0) {w=ww; x=xx; y=yy; z=zz;}
+    // Rotation of angle (in rad) around the axis
+    Quaternion(Vector axis, double angle);
+    double norm() const;
+    // Back to a unit quaternion, after the rounding errors of the integrations
+    void normalize();
+    Quaternion conjugate() const {return Quaternion(w, -x, -y, -z);}
+    // Rotates a vector, and with the inverse rotation
+    Vector rotate(const Vector &v) const;
+    Vector inverseRotate(const Vector &v) const;
+    // Column major rotation matrix, for glMultMatrixd
+    void getMatrix(double m[16]) const;
+    // Turns at the angular speed omega (in rad/s, world coordinates) during delta_t
+    void integrate(const Vector &omega, double delta_t);
+};
+
+
 // Compute the distance between two points
 double distance(Point p1, Point p2);
 
@@ -54,5 +77,9 @@ Vector operator*(const double &k, const Vector &v);
 double operator*(const Vector &v1, const Vector &v2);
 // Vector product
 Vector operator^(const Vector &v1, const Vector &v2);
+// Composition of rotations : q2 then q1
+Quaternion operator*(const Quaternion &q1, const Quaternion &q2);
+// Normalized linear interpolation between q1 (alpha = 0) and q2 (alpha = 1), along the shortest path
+Quaternion nlerp(const Quaternion &q1, const Quaternion &q2, double alpha);
 
 #endif // GEOMETRY_H_INCLUDED
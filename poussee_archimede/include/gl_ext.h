@@ -0,0 +1,52 @@
+#ifndef GL_EXT_H_INCLUDED
+#define GL_EXT_H_INCLUDED
+
+#include <SDL2/SDL_opengl.h>
+
+
+// OpenGL functions newer than OpenGL 1.1 are not exported by every OpenGL library
+// (opengl32 on Windows), their address is asked to the driver once the context exists
+
+// Returns the address of an OpenGL function, SDL_GL_GetProcAddress for example
+typedef void* (*GLProcLoader)(const char* name);
+
+// Loads the functions, to be called after the OpenGL context creation
+// Returns false if vertex buffers are not supported
+bool load_gl_extensions(GLProcLoader loader);
+
+// Vertex buffer objects (OpenGL 1.5), otherwise client-side vertex arrays are used
+bool has_vertex_buffers();
+
+// Shaders (OpenGL 2.0) and instanced drawing (ARB_instanced_arrays or OpenGL 3.3)
+// Required by the instanced rendering of the spheres
+bool has_instancing();
+
+// True if the OpenGL implementation exposes the extension
+bool has_gl_extension(const char* name);
+
+extern PFNGLGENBUFFERSPROC pglGenBuffers;
+extern PFNGLDELETEBUFFERSPROC pglDeleteBuffers;
+extern PFNGLBINDBUFFERPROC pglBindBuffer;
+extern PFNGLBUFFERDATAPROC pglBufferData;
+
+extern PFNGLCREATESHADERPROC pglCreateShader;
+extern PFNGLDELETESHADERPROC pglDeleteShader;
+extern PFNGLSHADERSOURCEPROC pglShaderSource;
+extern PFNGLCOMPILESHADERPROC pglCompileShader;
+extern PFNGLGETSHADERIVPROC pglGetShaderiv;
+extern PFNGLGETSHADERINFOLOGPROC pglGetShaderInfoLog;
+extern PFNGLCREATEPROGRAMPROC pglCreateProgram;
+extern PFNGLDELETEPROGRAMPROC pglDeleteProgram;
+extern PFNGLATTACHSHADERPROC pglAttachShader;
+extern PFNGLBINDATTRIBLOCATIONPROC pglBindAttribLocation;
+extern PFNGLLINKPROGRAMPROC pglLinkProgram;
+extern PFNGLGETPROGRAMIVPROC pglGetProgramiv;
+extern PFNGLGETPROGRAMINFOLOGPROC pglGetProgramInfoLog;
+extern PFNGLUSEPROGRAMPROC pglUseProgram;
+extern PFNGLENABLEVERTEXATTRIBARRAYPROC pglEnableVertexAttribArray;
+extern PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray;
+extern PFNGLVERTEXATTRIBPOINTERPROC pglVertexAttribPointer;
+extern PFNGLVERTEXATTRIBDIVISORARBPROC pglVertexAttribDivisor;
+extern PFNGLDRAWELEMENTSINSTANCEDARBPROC pglDrawElementsInstanced;
+
+#endif // GL_EXT_H_INCLUDED
@@ -0,0 +1,62 @@
+#ifndef HULL_H_INCLUDED
+#define HULL_H_INCLUDED
+
+#include <vector>
+#include "geometry.h"
+#include "thread_pool.h"
+
+
+// Triangles of a chunk of the hydrostatic loops
+// The partial sums of the chunks are added in chunk order : same results whatever the threads
+const int HULL_GRAIN = 4096;
+
+
+// Hydrostatic load on a hull
+class HullForces
+{
+public:
+    Vector force; // Buoyancy (N)
+    Vector torque; // About the given center (N.m)
+    double volume; // Submerged volume (m^3)
+    HullForces() {volume = 0.0;}
+    void operator+=(const HullForces& f);
+};
+
+
+// Closed triangle mesh of a floating body, normals outwards (counter clockwise seen from outside)
+// The vertices are in the body coordinates, each coordinate in its own array for the vector loops
+class Hull
+{
+private:
+    std::vector<double> ax, ay, az; // First vertex of each triangle
+    std::vector<double> bx, by, bz;
+    std::vector<double> cx, cy, cz;
+
+public:
+    int size() const {return (int)ax.size();}
+    void reserve(int n);
+    void clear();
+
+    void addTriangle(Point a, Point b, Point c);
+    // Rectangle of a Cube_face : org, org + l v1, org + l v1 + w v2, org + w v2, normal v1 ^ v2
+    void addQuad(Point org, Vector v1, Vector v2, double l, double w);
+    // Box of size (sx, sy, sz) centered on the origin
+    void addBox(double sx, double sy, double sz);
+    // Imported mesh : x, y, z of each vertex and 3 indices per triangle
+    void addTriangles(const float *vertices, const unsigned int *indices, int number_of_triangles);
+
+    // Volume enclosed by the hull
+    double getVolume() const;
+
+    // Load of the water under the level, the body coordinates origin being at origin and turned by orientation
+    // Each triangle is clipped by the water plane and the pressure integrated exactly on
+    // the submerged part (the pressure is linear in depth); torque about center
+    // The water plane is moved in the body coordinates, the vertices are never transformed
+    HullForces hydrostatic(const Point& origin, const Quaternion& orientation, double waterLevel, const Point& center) const;
+    // Same, the triangles are spread over the threads of the pool
+    HullForces hydrostatic(const Point& origin, const Quaternion& orientation, double waterLevel, const Point& center, ThreadPool& pool) const;
+    // Partial sums of the triangles [begin, end[
+    HullForces hydrostatic(const Point& origin, const Quaternion& orientation, double waterLevel, const Point& center, int begin, int end) const;
+};
+
+#endif // HULL_H_INCLUDED
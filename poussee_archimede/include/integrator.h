@@ -0,0 +1,111 @@
+#ifndef INTEGRATOR_H_INCLUDED
+#define INTEGRATOR_H_INCLUDED
+
+#include "geometry.h"
+
+
+// Relative and absolute tolerance of the adaptive integrator, on positions (m) and speeds (m/s)
+const double RK45_TOLERANCE = 1e-6;
+
+// Shortest step of the adaptive integrator (s), accepted whatever the error
+const double RK45_MIN_STEP = 1e-6;
+
+// Longest step of the adaptive integrator (s) : the forces are taken as they are at its start,
+// the water moving meanwhile is only seen at the next step
+const double RK45_MAX_STEP = 0.05;
+
+
+// Forces acting on a body, as the acceleration at a given state
+class ForceModel
+{
+public:
+    virtual ~ForceModel() {}
+    virtual Vector acceleration(const Point& pos, const Vector& spd) const = 0;
+};
+
+
+// Integration schemes
+enum IntegratorType {INTEGRATOR_EULER, INTEGRATOR_VERLET, INTEGRATOR_RK4, INTEGRATOR_RK45};
+
+
+// Advances the position and speed of a body
+// One instance per body : the schemes may keep data from one step to the next
+class Integrator
+{
+protected:
+    long evaluations; // Calls to the force model since the creation
+
+public:
+    Integrator() {evaluations = 0;}
+    virtual ~Integrator() {}
+    virtual IntegratorType getType() const = 0;
+    long getEvaluations() const {return evaluations;}
+    // Advances pos and spd of delta_t under the forces of the model
+    virtual void step(const ForceModel& model, Point& pos, Vector& spd, double delta_t) = 0;
+};
+
+
+// Semi-implicit (symplectic) Euler : v' = v + dt a(p, v), p' = p + dt v'
+class EulerIntegrator : public Integrator
+{
+public:
+    IntegratorType getType() const {return INTEGRATOR_EULER;}
+    void step(const ForceModel& model, Point& pos, Vector& spd, double delta_t);
+};
+
+
+// Velocity Verlet, second order and symplectic
+// The forces also depend on the water moved between two steps : the acceleration is never kept
+class VerletIntegrator : public Integrator
+{
+public:
+    IntegratorType getType() const {return INTEGRATOR_VERLET;}
+    void step(const ForceModel& model, Point& pos, Vector& spd, double delta_t);
+};
+
+
+// Classical Runge-Kutta, fourth order
+class RK4Integrator : public Integrator
+{
+public:
+    IntegratorType getType() const {return INTEGRATOR_RK4;}
+    void step(const ForceModel& model, Point& pos, Vector& spd, double delta_t);
+};
+
+
+// Dormand-Prince Runge-Kutta 5(4) with step size control
+// The steps follow the error, not the calls : short ones at the impacts, and in calm phases
+// steps over several calls, the calls in between only interpolate the step (no force evaluation)
+// The forces of a step are those of the model given when it starts
+// The body moved by someone else (collisions) : the rest of the current step starts again from there,
+// the correction carried to its end, and the step length is kept
+class RK45Integrator : public Integrator
+{
+private:
+    double start[6], end[6]; // State at the start and at the end of the current step, position then speed
+    double slope[2][6]; // Derivatives at the start and at the end of the current step
+    double span; // Length of the current step, 0 : no step yet
+    double elapsed; // Time reached by the calls since the start of the current step
+    double given[6]; // State given back by the last call
+    double guess; // Length of the next step
+    long rejected; // Steps done again with a shorter one
+    long steps; // Accepted steps
+
+    // Next step, from the end of the current one, as long as the error allows
+    void advance(const ForceModel& model);
+
+public:
+    RK45Integrator() {span = elapsed = guess = 0.0; rejected = steps = 0;}
+    IntegratorType getType() const {return INTEGRATOR_RK45;}
+    long getRejected() const {return rejected;}
+    long getSteps() const {return steps;}
+    void step(const ForceModel& model, Point& pos, Vector& spd, double delta_t);
+};
+
+
+// New integrator of the given type, to be deleted by the caller
+Integrator* create_integrator(IntegratorType type);
+
+const char* integrator_name(IntegratorType type);
+
+#endif // INTEGRATOR_H_INCLUDED
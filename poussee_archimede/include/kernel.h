@@ -0,0 +1,43 @@
+#ifndef KERNEL_H_INCLUDED
+#define KERNEL_H_INCLUDED
+
+
+// Arrays of a batch of spheres handed to the buoyancy kernel
+// Positions and speeds are updated in place
+class BodyArrays
+{
+public:
+    double *px, *py, *pz; // Center positions
+    double *vx, *vy, *vz; // Speeds
+    double *wx, *wy, *wz; // Angular speeds (rad/s), only changed by the contacts
+    const double *radius;
+    const double *volume;
+    const double *invMass; // 1 / mass
+    const double *invInertia; // 1 / moment of inertia, solid spheres
+    int count;
+};
+
+
+// Instruction sets of the buoyancy kernel
+enum KernelLevel {KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2};
+
+// Best instruction set supported by the running CPU
+KernelLevel detect_kernel_level();
+
+// Instruction set used by buoyancy_step, detected at first call unless forced
+KernelLevel get_kernel_level();
+void set_kernel_level(KernelLevel level);
+const char* kernel_level_name(KernelLevel level);
+
+// Advances all the spheres of one time step (semi-implicit Euler)
+// Same model as SphereForces integrated by EulerIntegrator, without branches
+void buoyancy_step(BodyArrays& bodies, double delta_t);
+// Same on the bodies [begin, end[ only
+void buoyancy_step(BodyArrays& bodies, double delta_t, int begin, int end);
+
+// One implementation per instruction set
+void buoyancy_step_scalar(BodyArrays& bodies, double delta_t, int begin, int end);
+void buoyancy_step_sse2(BodyArrays& bodies, double delta_t, int begin, int end);
+void buoyancy_step_avx2(BodyArrays& bodies, double delta_t, int begin, int end);
+
+#endif // KERNEL_H_INCLUDED
@@ -0,0 +1,80 @@
+#ifndef MESH_H_INCLUDED
+#define MESH_H_INCLUDED
+
+#include <vector>
+#include <SDL2/SDL_opengl.h>
+#include "geometry.h"
+
+
+// Indexed triangle mesh with normals
+// Geometry is built once on the CPU, then stored in vertex buffers when available
+// The buffers and the drawing are in mesh_render.cpp, only built with the OpenGL targets
+class Mesh
+{
+private:
+    std::vector<GLfloat> vertices; // x, y, z of each vertex
+    std::vector<GLfloat> normals; // Unit normal of each vertex
+    std::vector<GLuint> indices; // 3 vertices per triangle
+    GLuint vertexBuffer, indexBuffer; // 0 when not uploaded
+    // Set by upload : the meshes are also built without the OpenGL functions (headless runner)
+    PFNGLDELETEBUFFERSPROC deleteBuffers;
+
+public:
+    Mesh();
+    ~Mesh();
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    int getVertexCount() const {return (int)vertices.size() / 3;}
+    int getTriangleCount() const {return (int)indices.size() / 3;}
+    const std::vector<GLfloat>& getVertices() const {return vertices;}
+    const std::vector<GLfloat>& getNormals() const {return normals;}
+    const std::vector<GLuint>& getIndices() const {return indices;}
+    // Buffers holding the vertices (then the normals) and the indices, 0 if not uploaded
+    GLuint getVertexBuffer() const {return vertexBuffer;}
+    GLuint getIndexBuffer() const {return indexBuffer;}
+
+    void clear();
+    // Returns the index of the new vertex
+    GLuint addVertex(GLfloat x, GLfloat y, GLfloat z, GLfloat nx, GLfloat ny, GLfloat nz);
+    void addTriangle(GLuint i1, GLuint i2, GLuint i3);
+
+    // Copies the geometry in vertex buffers, to be called with a current OpenGL context
+    // Does nothing if vertex buffers are not supported : the mesh is drawn from memory
+    void upload();
+    // Frees the vertex buffers
+    void release();
+    // Draws the triangles in the current model view matrix
+    void draw() const;
+
+    // Sphere of radius 1 centered on the origin
+    void buildSphere(int slices, int stacks);
+};
+
+
+// Number of sphere levels of detail
+const int SPHERE_LOD_COUNT = 5;
+
+// Slices of each level, half as many stacks
+const int SPHERE_LOD_SLICES[SPHERE_LOD_COUNT] = {8, 16, 32, 64, 128};
+
+// Unit sphere mesh of a level of detail (0 : coarsest)
+// Built and uploaded once at first use, shared by all spheres (mesh_render.cpp)
+const Mesh& get_sphere_mesh(int lod);
+
+// Relative margin around the level bounds, so that a sphere at the limit
+// distance doesn't change level at each frame
+const double SPHERE_LOD_HYSTERESIS = 0.2;
+
+// Camera used to choose the levels of detail, to be set before rendering the forms
+// eye : camera position in world coordinates, fovy : vertical field of view (degrees)
+void set_lod_view(const Point& eye, double fovy, int viewport_height);
+
+// Radius in pixels of a sphere seen from the camera
+double projected_radius(const Point& center, double radius);
+
+// Level of detail for a sphere of the given radius on screen (pixels)
+// The current level (-1 : none yet) is kept while still close enough to the ideal one
+int select_sphere_lod(double screen_radius, int current_lod);
+
+#endif // MESH_H_INCLUDED
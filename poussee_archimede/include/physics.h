@@ -0,0 +1,50 @@
+#ifndef PHYSICS_H_INCLUDED
+#define PHYSICS_H_INCLUDED
+
+#include <algorithm>
+
+
+// Constants of the buoyancy model, shared by Sphere and the batched bodies
+// International system units
+
+// Gravity acceleration (m/s^2)
+const double GRAVITY = 9.81;
+
+// Water density (kg/m^3)
+const double WATER_DENSITY = 1000.0;
+
+// Height of the water surface in the tank (m)
+const double WATER_LEVEL = 0.5;
+
+// Drag coefficient of a sphere in water (no unit)
+// Quadratic drag 1/2 rho Cd A |v| v, A : cross section times the submerged portion
+const double DRAG_COEFFICIENT = 0.47;
+
+// Damping of the waves (1/s)
+const double WAVE_DAMPING = 0.5;
+
+// Default density of the spheres (kg/m^3), they float half submerged
+const double SPHERE_DENSITY = 500.0;
+
+
+
+// Submerged part of a sphere of radius r whose bottom is depth under the water
+// Exact volume of the spherical cap of height h = 2 r t : V = pi h^2 (3 r - h) / 3
+// i.e. t^2 (3 - 2 t) of the sphere volume, with t = clamp(depth / 2 r, 0, 1)
+// No branch : same expression in the batched kernels
+inline double submerged_portion(double depth, double r)
+{
+    double t = std::min(std::max(depth / (2.0 * r), 0.0), 1.0);
+    return t * t * (3.0 - 2.0 * t);
+}
+
+// Distance from the sphere center down to the center of buoyancy (centroid of the submerged cap)
+// 3 (2 r - h)^2 / (4 (3 r - h)) for a cap of height h : r just touching the water, 0 fully submerged
+// No branch either, 3 r - h >= r never vanishes
+inline double buoyancy_center_depth(double depth, double r)
+{
+    double h = std::min(std::max(depth, 0.0), 2.0 * r);
+    return 3.0 * (2.0 * r - h) * (2.0 * r - h) / (4.0 * (3.0 * r - h));
+}
+
+#endif // PHYSICS_H_INCLUDED
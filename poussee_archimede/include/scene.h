@@ -0,0 +1,164 @@
+#ifndef SCENE_H_INCLUDED
+#define SCENE_H_INCLUDED
+
+#include "forms.h"
+#include "form_pool.h"
+#include "bodies.h"
+#include "collision.h"
+#include "thread_pool.h"
+
+
+// Cells of the waves grid along each side of the tank
+const int WAVE_CELLS = 64;
+
+// Forms of a group updated by a thread at a time
+const int FORM_GRAIN = 64;
+
+// Distance between the water particles at rest (m) : 64000 particles in the tank
+const double FLUID_SPACING = 0.025;
+
+
+// Models of the water in the tank
+// Waves : height field under a B-spline surface, the spheres float on the level under them
+// Particles : smoothed particle hydrodynamics, the spheres are pushed by the particles and push them back
+enum WaterModel {WATER_WAVES, WATER_PARTICLES};
+
+
+// Forms of one class of a scene, contiguous, with their handles in the same order
+template <class T>
+class FormGroup
+{
+public:
+    std::vector<T*> forms;
+    std::vector<FormHandle> handles;
+
+    int size() const {return (int)forms.size();}
+    // Returns the place of the form in the group
+    int add(T* form, FormHandle handle)
+    {
+        forms.push_back(form);
+        handles.push_back(handle);
+        return (int)forms.size() - 1;
+    }
+    // The last form takes the place of the removed one, returns its handle (null if it was the removed one)
+    FormHandle remove(int place)
+    {
+        int last = (int)forms.size() - 1;
+        FormHandle moved;
+        if (place != last)
+        {
+            forms[place] = forms[last];
+            handles[place] = handles[last];
+            moved = handles[place];
+        }
+        forms.pop_back();
+        handles.pop_back();
+        return moved;
+    }
+    void clear() {forms.clear(); handles.clear();}
+};
+
+
+// Forms of the simulation, built in the pools of an arena and grouped by class
+// Each group is walked as a contiguous array of its class, the groups in the order
+// spheres, cube faces, surfaces, fluids : the transparent water is drawn last
+// The classes are final : the update and render calls of a group are direct, not virtual
+// A handle stays valid until its form is removed, adding or removing a form is O(1) :
+// the last form of the group takes the place of the removed one
+// The scene also keeps the collisions of its spheres, the bodies following the order of their group
+class Scene
+{
+private:
+    FormArena arena;
+    FormGroup<Sphere> spheres;
+    FormGroup<Cube_face> faces;
+    FormGroup<Surface> surfaces;
+    FormGroup<Fluid> fluids;
+    std::vector<int> places; // Place in its group of the form of each slot of the arena
+    FormHandle last;
+
+    CollisionSystem collisions;
+    BodyStore bodies;
+
+    FormGroup<Sphere>& getGroup(Sphere*) {return spheres;}
+    FormGroup<Cube_face>& getGroup(Cube_face*) {return faces;}
+    FormGroup<Surface>& getGroup(Surface*) {return surfaces;}
+    FormGroup<Fluid>& getGroup(Fluid*) {return fluids;}
+    // The moved form of a group gets its new place
+    void setPlace(FormHandle handle, int place);
+    // The other forms no longer refer to the removed one
+    void detachSphere(int place);
+    void detachSurface(Surface *surface);
+    void detachFluid(Fluid *fluid);
+
+public:
+    Scene() {}
+    ~Scene() {clear();}
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // Builds a form of class T (Sphere, Cube_face, Surface or Fluid) at the end of its group
+    template <class T, class... Args>
+    T* add(Args&&... args)
+    {
+        last = arena.create<T>(std::forward<Args>(args)...);
+        T* form = arena.get<T>(last);
+        setPlace(last, getGroup(form).add(form, last));
+        return form;
+    }
+    // Handle of the last form added
+    FormHandle getLastHandle() const {return last;}
+    // Destroys the form of the handle, false if it was already removed
+    // A removed sphere leaves the collisions and the fluid, the spheres on a removed surface or fluid
+    // are then in still water
+    bool remove(FormHandle handle);
+    // Destroys all the forms, the collision walls are kept
+    void clear();
+
+    Form* get(FormHandle handle) const {return arena.get(handle);}
+    template <class T>
+    T* get(FormHandle handle) const {return arena.get<T>(handle);}
+
+    // Forms of each class
+    const std::vector<Sphere*>& getSpheres() const {return spheres.forms;}
+    const std::vector<Cube_face*>& getFaces() const {return faces.forms;}
+    const std::vector<Surface*>& getSurfaces() const {return surfaces.forms;}
+    const std::vector<Fluid*>& getFluids() const {return fluids.forms;}
+
+    // All the forms, group after group
+    int size() const {return arena.size();}
+    Form* getForm(int i) const;
+
+    // Collisions of the spheres with each other and with the walls
+    CollisionSystem& getCollisions() {return collisions;}
+    BodyStore& getBodies() {return bodies;}
+};
+
+
+// Creates the forms of the simulation (tank, water and spheres)
+// The spheres move with the given integration scheme, their collisions are found with the given broad phase
+// The forms of the scene are replaced, returns the actual number of forms
+int create_scene(Scene& scene, IntegratorType integrator = INTEGRATOR_EULER,
+                 BroadPhaseType broad_phase = BROADPHASE_GRID, WaterModel water = WATER_WAVES);
+
+// Fills the store with a batch of spheres spread over the tank, dropped from above the water
+void create_bodies(BodyStore& bodies, int number_of_bodies);
+
+// Adds the solid faces of the scene as collision walls, facing the middle of the faces
+void add_walls(CollisionSystem& collisions, Scene& scene);
+
+// Updating forms for animation
+// The waves and the fluids are advanced first, then the forms group by group, then the spheres are pushed out of each other and of the tank
+// The state before the step is kept for rendering interpolation
+void update(Scene& scene, double delta_t);
+// Same, the forms are independent : the forms of each group are shared by the threads of the pool
+void update(Scene& scene, double delta_t, ThreadPool& pool);
+
+// Saves the current state of the forms as their previous state
+void store_states(Scene& scene);
+
+// Computes the rendering state of the forms between the two last physics steps
+// alpha = 0 : previous state, alpha = 1 : current state
+void interpolate(Scene& scene, double alpha);
+
+#endif // SCENE_H_INCLUDED
@@ -0,0 +1,105 @@
+#ifndef SPATIAL_SORT_H_INCLUDED
+#define SPATIAL_SORT_H_INCLUDED
+
+#include <vector>
+#include "geometry.h"
+
+
+// Bits of each cell coordinate in a Morton code, 30 bits codes
+const int MORTON_BITS = 10;
+
+// Steps between two reorderings of the batched bodies
+// They hardly move in a step : sorted again only once in a while
+const int MORTON_INTERVAL = 16;
+
+
+// Interleaves the bits of the cell coordinates (z y x z y x ...) :
+// cells close in space mostly get close codes (Z-order curve)
+unsigned int morton_code(unsigned int x, unsigned int y, unsigned int z);
+
+
+// Orders of the cells of a spatial sort
+// Morton : Z-order curve over the cells
+// Morton rows : the cells of a row along x stay contiguous, the rows follow a Z-order curve over y and z,
+// a row of neighbour cells is then a single range of points
+enum SpatialOrder {ORDER_MORTON, ORDER_MORTON_ROWS};
+
+
+// Sorts points by cell of a bounded grid of cubic cells, the cells following a Z-order curve,
+// so that the points close in space get close in memory once their arrays are reordered
+// Gives the order of the points and the range of the sorted points of each cell
+// The points outside of the grid are counted in the nearest border cell
+class SpatialSort
+{
+private:
+    SpatialOrder curve;
+    Point low;
+    double cellSize;
+    int countX, countY, countZ; // Cells in each direction, at most 2^MORTON_BITS
+    int interval; // Calls of isDue between two sorts
+    long calls;
+
+    std::vector<int> cellRank; // Position of each cell (x fastest) along the curve
+    std::vector<int> cellStart; // First sorted point of each cell in curve order, one more cell at the end
+    std::vector<int> pointCell; // Curve position of the cell of each point
+    std::vector<int> order; // Original index of each sorted point
+    std::vector<int> rank; // Sorted index of each original point
+    std::vector<int> next;
+
+    int cellCoordinate(double p, double org, int count) const;
+    int cellIndex(int x, int y, int z) const {return (z * countY + y) * countX + x;}
+
+public:
+    SpatialSort(SpatialOrder o = ORDER_MORTON, int n = 1);
+
+    // Grid covering the box low - high, the cells are enlarged if there are too many
+    void setGrid(Point low, Point high, double size);
+    SpatialOrder getOrdering() const {return curve;}
+    double getCellSize() const {return cellSize;}
+    int getCountX() const {return countX;}
+    int getCountY() const {return countY;}
+    int getCountZ() const {return countZ;}
+    // Cell of a point along each axis, within the grid
+    int getCellX(double x) const {return cellCoordinate(x, low.x, countX);}
+    int getCellY(double y) const {return cellCoordinate(y, low.y, countY);}
+    int getCellZ(double z) const {return cellCoordinate(z, low.z, countZ);}
+
+    // True once every interval calls, starting with the first one
+    bool isDue() {return calls++ % interval == 0;}
+    void setInterval(int n) {interval = n;}
+
+    // Counting sort of the points by cell, the points of a cell stay in their previous order
+    void sort(const double *x, const double *y, const double *z, int count);
+
+    int size() const {return (int)order.size();}
+    const std::vector<int>& getOrder() const {return order;}
+    const std::vector<int>& getRank() const {return rank;}
+    // Sorted points of the cell (x, y, z) : [begin, end[
+    void getRange(int x, int y, int z, int& begin, int& end) const
+    {
+        int r = cellRank[cellIndex(x, y, z)];
+        begin = cellStart[r];
+        end = cellStart[r + 1];
+    }
+    // Sorted points of the cells first to last along x of the row (y, z), Morton rows order only
+    void getRowRange(int first, int last, int y, int z, int& begin, int& end) const
+    {
+        int row = cellIndex(0, y, z);
+        begin = cellStart[cellRank[row + first]];
+        end = cellStart[cellRank[row + last] + 1];
+    }
+
+    // Puts a field of the points in sorted order, the buffer is swapped with it
+    template <class T>
+    void apply(std::vector<T>& field, std::vector<T>& buffer) const
+    {
+        buffer.resize(field.size());
+        for (size_t k = 0; k < order.size(); k++)
+        {
+            buffer[k] = field[order[k]];
+        }
+        field.swap(buffer);
+    }
+};
+
+#endif // SPATIAL_SORT_H_INCLUDED
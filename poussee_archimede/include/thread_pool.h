@@ -0,0 +1,74 @@
+#ifndef THREAD_POOL_H_INCLUDED
+#define THREAD_POOL_H_INCLUDED
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+
+// Pool of worker threads for data parallel loops
+// A loop is cut in chunks spread over one queue per thread; each thread takes
+// its own chunks first then steals the chunks of the other queues, so that
+// uneven chunks don't leave threads idle
+class ThreadPool
+{
+private:
+    // Chunk of a loop : [begin, end[
+    class Range
+    {
+    public:
+        int begin, end;
+        Range(int b = 0, int e = 0) {begin = b; end = e;}
+    };
+
+    // Chunks queue of a thread, the calling thread uses the first one
+    class WorkQueue
+    {
+    public:
+        std::mutex lock;
+        std::deque<Range> ranges;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<WorkQueue> queues;
+    const std::function<void(int, int)>* job; // Loop body of the running parallelFor
+    std::atomic<int> remaining; // Chunks not finished yet
+    std::mutex jobLock;
+    std::condition_variable jobStart, jobDone;
+    unsigned long generation; // Incremented for each new loop
+    bool stopping;
+    bool deterministic;
+
+    void workerLoop(int index);
+    // Runs one chunk, from its own queue or stolen, returns false if none is left
+    bool runOne(int index);
+
+public:
+    // 0 thread : one per hardware thread
+    ThreadPool(int number_of_threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads, including the calling thread
+    int size() const {return (int)queues.size();}
+
+    // In deterministic mode (default), the chunks only depend on the grain size and
+    // never on the number of threads : per chunk results combined in chunk order
+    // are the same whatever the number of threads
+    bool isDeterministic() const {return deterministic;}
+    void setDeterministic(bool det) {deterministic = det;}
+
+    // Calls fn(begin, end) on chunks of [0, count[ of at least grain elements
+    // and returns when all are done. Nested calls are run on the calling thread
+    void parallelFor(int count, int grain, const std::function<void(int, int)>& fn);
+
+    // Chunk boundaries used by parallelFor for count elements
+    int chunkSize(int count, int grain) const;
+};
+
+#endif // THREAD_POOL_H_INCLUDED
@@ -0,0 +1,26 @@
+#ifndef TIMESTEP_H_INCLUDED
+#define TIMESTEP_H_INCLUDED
+
+
+// Fixed time step scheduler
+// Accumulates the real elapsed time and converts it in a number of physics steps
+// of constant duration, the remaining time is used to interpolate the rendering
+class FixedTimeStep
+{
+private:
+    double step; // Physics time step (s)
+    int maxSubsteps; // Max number of physics steps run for one frame
+    double maxFrameTime; // Longer frames are clamped to avoid the spiral of death
+    double accumulator; // Elapsed time not yet simulated (s)
+
+public:
+    FixedTimeStep(double dt = 1e-2, int max_substeps = 10, double max_frame_time = 0.25);
+    double getStep() const {return step;}
+    // Adds the elapsed time of a frame, returns the number of physics steps to run
+    int advance(double frame_time);
+    // Fraction of a step remaining in the accumulator, in [0, 1[
+    // Used to interpolate between the previous and the current physics states
+    double getAlpha() const {return accumulator / step;}
+};
+
+#endif // TIMESTEP_H_INCLUDED
@@ -0,0 +1,94 @@
+#ifndef WAVES_H_INCLUDED
+#define WAVES_H_INCLUDED
+
+#include <vector>
+#include <mutex>
+#include "thread_pool.h"
+
+
+// Columns of the blocks swept by the stencil : the 3 rows read for a block stay in the L1 cache
+const int WAVE_BLOCK_COLUMNS = 512;
+
+// Rows of a chunk of the parallel loops
+const int WAVE_BLOCK_ROWS = 16;
+
+// Part of the water moved by a body that makes waves, the rest raises the whole surface
+const double WAVE_COUPLING = 0.2;
+
+// Highest c * dt / dx of a sub step, the scheme is stable below 1 / sqrt(2)
+const double WAVE_MAX_COURANT = 0.5;
+
+
+// Water surface simulated with the 2D wave equation on a regular grid of cells
+//  d2h/dt2 = c^2 (d2h/dx2 + d2h/dz2), c = sqrt(g * depth) as for shallow water
+// The walls reflect the waves (ghost cells copy the border cells) so the volume of water is kept
+// Cell (i, j) : i along x, j along z
+class WaveField
+{
+private:
+    int countX, countZ; // Cells in each direction
+    int stride; // countX + 2 : one ghost cell on each side
+    double originX, originZ; // Corner of the first cell
+    double cellSize;
+    double restLevel; // Height of the still water, rises with the bodies entering the water
+    double speed; // Waves speed c
+    std::vector<double> height; // Above the rest level, countZ + 2 rows of stride cells
+    std::vector<double> velocity; // dh/dt
+
+    // Volume moved by a body, applied at the next step
+    class Push
+    {
+    public:
+        double x, z, radius, volume;
+        bool operator<(const Push& p) const;
+    };
+    std::vector<Push> pushes;
+    std::mutex pushesMutex;
+
+    void applyPushes();
+    void updateGhosts();
+    // Velocities then heights of the rows [begin, end[
+    void accelerateRows(double delta_t, int begin, int end);
+    void moveRows(double delta_t, int begin, int end);
+    int getSubsteps(double delta_t) const;
+
+public:
+    // depth : water depth, giving the waves speed
+    WaveField(int countX, int countZ, double originX, double originZ, double cellSize, double level, double depth);
+    WaveField(const WaveField&) = delete;
+    WaveField& operator=(const WaveField&) = delete;
+
+    int getCountX() const {return countX;}
+    int getCountZ() const {return countZ;}
+    double getCellSize() const {return cellSize;}
+    double getRestLevel() const {return restLevel;}
+    double getSpeed() const {return speed;}
+
+    // Height of a cell above the rest level
+    double getHeight(int i, int j) const {return height[(j + 1) * stride + i + 1];}
+    void setHeight(int i, int j, double h) {height[(j + 1) * stride + i + 1] = h;}
+    // Water level at (x, z), interpolated between the cell centers, clamped to the grid
+    double getLevel(double x, double z) const;
+    // Water above the rest level (m^3), kept by the steps and the pushes
+    double getVolume() const;
+
+    // A body moves the given volume of water (volume < 0 : the body leaves the water)
+    // The water rises around (x, z) between radius and twice the radius, and everywhere for the rest
+    // Can be called by several threads : the pushes are applied in a fixed order at the next step
+    void push(double x, double z, double radius, double volume);
+
+    // Advances the waves, in sub steps short enough to be stable
+    void step(double delta_t);
+    // Same, the rows are spread over the threads of the pool
+    void step(double delta_t, ThreadPool& pool);
+};
+
+
+// Kernels of the stencil, selected with get_kernel_level()
+// n cells of a row, h and v pointing to the first one, rows of stride cells
+// v = keep * (v + k * (sum of the 4 neighbours - 4 h))
+void wave_accelerate(const double *h, double *v, int stride, int n, double k, double keep);
+// h = h + dt * v
+void wave_move(double *h, const double *v, int n, double delta_t);
+
+#endif // WAVES_H_INCLUDED
@@ -1,13 +1,45 @@
+#include <cmath>
 #include "animation.h"
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
 
 Animation::Animation(double ph, double th, Vector accel, Vector speed, Point p)
 {
     // Constructor
     // Initialization
-    phi = ph;
-    theta = th;
+    orient = Quaternion(Vector(0, 1, 0), ph * M_PI / 180.0) * Quaternion(Vector(1, 0, 0), th * M_PI / 180.0);
+    prevOrient = orient;
+    renderOrient = orient;
     acc = accel;
     spd = speed;
     pos = p;
+    prevPos = p;
+    renderPos = p;
+}
+
+
+void Animation::interpolate(double alpha)
+{
+    renderPos = Point(prevPos.x + alpha * (pos.x - prevPos.x),
+                      prevPos.y + alpha * (pos.y - prevPos.y),
+                      prevPos.z + alpha * (pos.z - prevPos.z));
+    renderOrient = nlerp(prevOrient, orient, alpha);
+}
+
+
+void Animation::applyTorque(const Vector& torque, double delta_t)
+{
+    // I dw/dt = torque - w ^ (I w), in the local coordinates where I is diagonal
+    Vector w = toLocal(angSpd);
+    Vector t = toLocal(torque);
+    Vector iw(inertia.x * w.x, inertia.y * w.y, inertia.z * w.z);
+    Vector dw = t - (w ^ iw);
+
+    // Axes without inertia don't turn
+    w.x = inertia.x > 0 ? w.x + delta_t * dw.x / inertia.x : 0.0;
+    w.y = inertia.y > 0 ? w.y + delta_t * dw.y / inertia.y : 0.0;
+    w.z = inertia.z > 0 ? w.z + delta_t * dw.z / inertia.z : 0.0;
+    angSpd = toWorld(w);
 }
@@ -0,0 +1,478 @@
+#include <iostream>
+#include <algorithm>
+#include "batch.h"
+#include "gl_ext.h"
+
+
+// Floats per instance : center and radius, then color
+const int INSTANCE_SIZE = 8;
+
+// Attribute locations of the instancing shaders
+const GLuint ATTRIB_POSITION = 0;
+const GLuint ATTRIB_INSTANCE = 1;
+const GLuint ATTRIB_COLOR = 2;
+
+// GLSL 1.20 with the fixed function matrices and lights, for OpenGL 2.1 contexts
+// Lighting follows the fixed pipeline setup (light 0, color material)
+static const char* VERTEX_SHADER =
+    "#version 120\n"
+    "attribute vec3 position;\n" // Unit sphere : also the normal
+    "attribute vec4 instance;\n" // Center and radius
+    "attribute vec4 color;\n"
+    "varying vec3 normal;\n"
+    "varying vec3 eyePos;\n"
+    "varying vec4 col;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 eye = gl_ModelViewMatrix * vec4(instance.xyz + instance.w * position, 1.0);\n"
+    "    eyePos = eye.xyz;\n"
+    "    normal = gl_NormalMatrix * position;\n"
+    "    col = color;\n"
+    "    gl_Position = gl_ProjectionMatrix * eye;\n"
+    "}\n";
+
+static const char* FRAGMENT_SHADER =
+    "#version 120\n"
+    "varying vec3 normal;\n"
+    "varying vec3 eyePos;\n"
+    "varying vec4 col;\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 n = normalize(normal);\n"
+    "    vec3 l = normalize(gl_LightSource[0].position.xyz);\n"
+    "    float diffuse = max(dot(n, l), 0.0);\n"
+    "    float specular = 0.0;\n"
+    "    if (diffuse > 0.0)\n"
+    "    {\n"
+    "        vec3 h = normalize(l + normalize(-eyePos));\n"
+    "        specular = pow(max(dot(n, h), 0.0), gl_FrontMaterial.shininess);\n"
+    "    }\n"
+    "    vec3 light = gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb\n"
+    "                 + diffuse * gl_LightSource[0].diffuse.rgb;\n"
+    "    gl_FragColor = vec4(col.rgb * light + specular * gl_LightSource[0].specular.rgb\n"
+    "                        * gl_FrontMaterial.specular.rgb, 1.0);\n"
+    "}\n";
+
+
+// Compiles a shader, returns 0 on error
+static GLuint compile_shader(GLenum type, const char* source)
+{
+    GLuint shader = pglCreateShader(type);
+    pglShaderSource(shader, 1, &source, NULL);
+    pglCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    pglGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (compiled != GL_TRUE)
+    {
+        char log[1024];
+        pglGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        std::cout << "Shader compilation error : " << log << std::endl;
+        pglDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+
+SphereBatch::SphereBatch()
+{
+    program = 0;
+    instanceBuffer = 0;
+    status = 0;
+}
+
+
+SphereBatch::~SphereBatch()
+{
+    if (program != 0)
+    {
+        pglDeleteProgram(program);
+    }
+    if (instanceBuffer != 0)
+    {
+        pglDeleteBuffers(1, &instanceBuffer);
+    }
+}
+
+
+bool SphereBatch::init()
+{
+    if (!has_instancing() || get_sphere_mesh(0).getVertexBuffer() == 0)
+    {
+        return false;
+    }
+
+    GLuint vertexShader = compile_shader(GL_VERTEX_SHADER, VERTEX_SHADER);
+    GLuint fragmentShader = compile_shader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+    if (vertexShader == 0 || fragmentShader == 0)
+    {
+        return false;
+    }
+
+    program = pglCreateProgram();
+    pglAttachShader(program, vertexShader);
+    pglAttachShader(program, fragmentShader);
+    pglBindAttribLocation(program, ATTRIB_POSITION, "position");
+    pglBindAttribLocation(program, ATTRIB_INSTANCE, "instance");
+    pglBindAttribLocation(program, ATTRIB_COLOR, "color");
+    pglLinkProgram(program);
+    // Kept alive by the program
+    pglDeleteShader(vertexShader);
+    pglDeleteShader(fragmentShader);
+
+    GLint linked = GL_FALSE;
+    pglGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE)
+    {
+        char log[1024];
+        pglGetProgramInfoLog(program, sizeof(log), NULL, log);
+        std::cout << "Shader link error : " << log << std::endl;
+        pglDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+
+    pglGenBuffers(1, &instanceBuffer);
+    return true;
+}
+
+
+int SphereBatch::size() const
+{
+    int count = 0;
+    for (int lod = 0; lod < SPHERE_LOD_COUNT; lod++)
+    {
+        count += instances[lod].size() / INSTANCE_SIZE;
+    }
+    return count;
+}
+
+
+void SphereBatch::clear()
+{
+    for (int lod = 0; lod < SPHERE_LOD_COUNT; lod++)
+    {
+        instances[lod].clear();
+    }
+}
+
+
+void SphereBatch::add(const Point& center, double radius, const Color& col, int lod)
+{
+    std::vector<GLfloat>& data = instances[lod];
+    data.push_back((GLfloat)center.x);
+    data.push_back((GLfloat)center.y);
+    data.push_back((GLfloat)center.z);
+    data.push_back((GLfloat)radius);
+    data.push_back(col.r);
+    data.push_back(col.g);
+    data.push_back(col.b);
+    data.push_back(col.t);
+}
+
+
+void SphereBatch::add(Sphere& sphere)
+{
+    add(sphere.getRenderCenter(), sphere.getRadius(), sphere.getColor(), sphere.updateLod());
+}
+
+
+void SphereBatch::add(const BodyStore& bodies, const Color& col, std::vector<int>& lods)
+{
+    lods.resize(bodies.size(), -1);
+    for (int i = 0; i < bodies.size(); i++)
+    {
+        Point center = bodies.getPos(i);
+        lods[i] = select_sphere_lod(projected_radius(center, bodies.getRadius(i)), lods[i]);
+        add(center, bodies.getRadius(i), col, lods[i]);
+    }
+}
+
+
+void SphereBatch::draw()
+{
+    if (status == 0)
+    {
+        status = init() ? 1 : -1;
+    }
+
+    for (int lod = 0; lod < SPHERE_LOD_COUNT; lod++)
+    {
+        if (instances[lod].empty())
+        {
+            continue;
+        }
+        if (status == 1)
+        {
+            drawInstanced(lod);
+        }
+        else
+        {
+            drawFallback(lod);
+        }
+    }
+    clear();
+}
+
+
+void SphereBatch::drawInstanced(int lod)
+{
+    const Mesh& mesh = get_sphere_mesh(lod);
+    const std::vector<GLfloat>& data = instances[lod];
+    GLsizei count = data.size() / INSTANCE_SIZE;
+
+    pglUseProgram(program);
+
+    // Shared unit sphere
+    pglBindBuffer(GL_ARRAY_BUFFER, mesh.getVertexBuffer());
+    pglEnableVertexAttribArray(ATTRIB_POSITION);
+    pglVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
+
+    // One center, radius and color per instance
+    pglBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    pglBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(GLfloat), data.data(), GL_STREAM_DRAW);
+    pglEnableVertexAttribArray(ATTRIB_INSTANCE);
+    pglVertexAttribPointer(ATTRIB_INSTANCE, 4, GL_FLOAT, GL_FALSE, INSTANCE_SIZE * sizeof(GLfloat), (const GLvoid*)0);
+    pglVertexAttribDivisor(ATTRIB_INSTANCE, 1);
+    pglEnableVertexAttribArray(ATTRIB_COLOR);
+    pglVertexAttribPointer(ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, INSTANCE_SIZE * sizeof(GLfloat), (const GLvoid*)(4 * sizeof(GLfloat)));
+    pglVertexAttribDivisor(ATTRIB_COLOR, 1);
+
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.getIndexBuffer());
+    pglDrawElementsInstanced(GL_TRIANGLES, mesh.getTriangleCount() * 3, GL_UNSIGNED_INT, (const GLvoid*)0, count);
+
+    // Back to the fixed pipeline state
+    pglVertexAttribDivisor(ATTRIB_INSTANCE, 0);
+    pglVertexAttribDivisor(ATTRIB_COLOR, 0);
+    pglDisableVertexAttribArray(ATTRIB_POSITION);
+    pglDisableVertexAttribArray(ATTRIB_INSTANCE);
+    pglDisableVertexAttribArray(ATTRIB_COLOR);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    pglUseProgram(0);
+}
+
+
+void SphereBatch::drawFallback(int lod)
+{
+    const Mesh& mesh = get_sphere_mesh(lod);
+    const std::vector<GLfloat>& data = instances[lod];
+
+    for (unsigned int i = 0; i < data.size(); i += INSTANCE_SIZE)
+    {
+        glPushMatrix();
+        glColor3f(data[i + 4], data[i + 5], data[i + 6]);
+        glTranslatef(data[i], data[i + 1], data[i + 2]);
+        glScalef(data[i + 3], data[i + 3], data[i + 3]);
+        mesh.draw();
+        glPopMatrix();
+    }
+}
+
+
+
+// Floats per face vertex : position then color
+const int FACE_VERTEX_SIZE = 7;
+
+
+FaceBatch::FaceBatch()
+{
+    vertexBuffer = 0;
+    indexBuffer = 0;
+    faceCount = 0;
+    uploaded = false;
+    sorted = false;
+}
+
+
+FaceBatch::~FaceBatch()
+{
+    if (vertexBuffer != 0)
+    {
+        pglDeleteBuffers(1, &vertexBuffer);
+    }
+    if (indexBuffer != 0)
+    {
+        pglDeleteBuffers(1, &indexBuffer);
+    }
+}
+
+
+void FaceBatch::clear()
+{
+    vertices.clear();
+    opaqueIndices.clear();
+    transparentIndices.clear();
+    transparentCenters.clear();
+    faceCount = 0;
+    uploaded = false;
+    sorted = false;
+}
+
+
+void FaceBatch::add(const Cube_face& face)
+{
+    Point corners[4];
+    face.getCorners(corners);
+    Color col = face.getColor();
+
+    GLuint first = vertices.size() / FACE_VERTEX_SIZE;
+    for (int i = 0; i < 4; i++)
+    {
+        vertices.push_back((GLfloat)corners[i].x);
+        vertices.push_back((GLfloat)corners[i].y);
+        vertices.push_back((GLfloat)corners[i].z);
+        vertices.push_back(col.r);
+        vertices.push_back(col.g);
+        vertices.push_back(col.b);
+        vertices.push_back(col.t);
+    }
+
+    // The quad as two triangles
+    GLuint quad[6] = {first, first + 1, first + 2, first, first + 2, first + 3};
+    if (face.isTransparent())
+    {
+        transparentIndices.insert(transparentIndices.end(), quad, quad + 6);
+        transparentCenters.push_back(Point(0.5 * (corners[0].x + corners[2].x),
+                                           0.5 * (corners[0].y + corners[2].y),
+                                           0.5 * (corners[0].z + corners[2].z)));
+    }
+    else
+    {
+        opaqueIndices.insert(opaqueIndices.end(), quad, quad + 6);
+    }
+
+    faceCount++;
+    uploaded = false;
+    sorted = false;
+}
+
+
+void FaceBatch::upload()
+{
+    if (has_vertex_buffers())
+    {
+        if (vertexBuffer == 0)
+        {
+            pglGenBuffers(1, &vertexBuffer);
+            pglGenBuffers(1, &indexBuffer);
+        }
+        pglBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        pglBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    uploadIndices();
+    uploaded = true;
+}
+
+
+void FaceBatch::uploadIndices()
+{
+    // Opaque faces then transparent faces in the same buffer
+    indices = opaqueIndices;
+    indices.insert(indices.end(), transparentIndices.begin(), transparentIndices.end());
+
+    if (indexBuffer != 0)
+    {
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        pglBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+}
+
+
+void FaceBatch::sortTransparent(const Point& eye)
+{
+    int count = transparentCenters.size();
+    std::vector<std::pair<double, int> > order(count);
+    for (int i = 0; i < count; i++)
+    {
+        order[i] = std::make_pair(-distance(eye, transparentCenters[i]), i);
+    }
+    // Farthest first
+    std::sort(order.begin(), order.end());
+
+    std::vector<GLuint> sortedIndices(transparentIndices.size());
+    std::vector<Point> sortedCenters(count);
+    for (int i = 0; i < count; i++)
+    {
+        int face = order[i].second;
+        std::copy(transparentIndices.begin() + 6 * face, transparentIndices.begin() + 6 * face + 6,
+                  sortedIndices.begin() + 6 * i);
+        sortedCenters[i] = transparentCenters[face];
+    }
+    transparentIndices.swap(sortedIndices);
+    transparentCenters.swap(sortedCenters);
+
+    sortEye = eye;
+    sorted = true;
+}
+
+
+void FaceBatch::drawRange(int first, int count)
+{
+    // No normal is given to the faces, they are lit as flat colored panels
+    glNormal3f(0.0f, 0.0f, 1.0f);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    if (vertexBuffer != 0)
+    {
+        pglBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glVertexPointer(3, GL_FLOAT, FACE_VERTEX_SIZE * sizeof(GLfloat), (const GLvoid*)0);
+        glColorPointer(4, GL_FLOAT, FACE_VERTEX_SIZE * sizeof(GLfloat), (const GLvoid*)(3 * sizeof(GLfloat)));
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (const GLvoid*)(first * sizeof(GLuint)));
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    else
+    {
+        glVertexPointer(3, GL_FLOAT, FACE_VERTEX_SIZE * sizeof(GLfloat), vertices.data());
+        glColorPointer(4, GL_FLOAT, FACE_VERTEX_SIZE * sizeof(GLfloat), vertices.data() + 3);
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, indices.data() + first);
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+
+void FaceBatch::drawOpaque()
+{
+    if (opaqueIndices.empty())
+    {
+        return;
+    }
+    if (!uploaded)
+    {
+        upload();
+    }
+
+    glDisable(GL_BLEND);
+    drawRange(0, opaqueIndices.size());
+}
+
+
+void FaceBatch::drawTransparent(const Point& eye)
+{
+    if (transparentIndices.empty())
+    {
+        return;
+    }
+    if (!uploaded)
+    {
+        upload();
+    }
+    // Only the order of the indices changes with the camera
+    if (!sorted || distance(eye, sortEye) > 1e-6)
+    {
+        sortTransparent(eye);
+        uploadIndices();
+    }
+
+    // One blending state for all the transparent faces
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    drawRange(opaqueIndices.size(), transparentIndices.size());
+    glDisable(GL_BLEND);
+}
@@ -0,0 +1,99 @@
+#include <cmath>
+#include "bodies.h"
+
+
+// Number of bodies stepped by a thread at once
+const int BODIES_GRAIN = 4096;
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+void BodyStore::reserve(int n)
+{
+    px.reserve(n); py.reserve(n); pz.reserve(n);
+    vx.reserve(n); vy.reserve(n); vz.reserve(n);
+    wx.reserve(n); wy.reserve(n); wz.reserve(n);
+    radius.reserve(n);
+    density.reserve(n);
+    volume.reserve(n);
+    mass.reserve(n);
+    invMass.reserve(n);
+    invInertia.reserve(n);
+}
+
+
+void BodyStore::clear()
+{
+    px.clear(); py.clear(); pz.clear();
+    vx.clear(); vy.clear(); vz.clear();
+    wx.clear(); wy.clear(); wz.clear();
+    radius.clear();
+    density.clear();
+    volume.clear();
+    mass.clear();
+    invMass.clear();
+    invInertia.clear();
+}
+
+
+int BodyStore::add(Point pos, Vector speed, double r, double dens, Vector angularSpeed)
+{
+    px.push_back(pos.x); py.push_back(pos.y); pz.push_back(pos.z);
+    vx.push_back(speed.x); vy.push_back(speed.y); vz.push_back(speed.z);
+    wx.push_back(angularSpeed.x); wy.push_back(angularSpeed.y); wz.push_back(angularSpeed.z);
+    radius.push_back(r);
+    density.push_back(dens);
+    volume.push_back((4.0/3.0) * M_PI * r * r * r);
+    mass.push_back(dens * volume.back());
+    invMass.push_back(1.0 / mass.back());
+    // Solid sphere : 2/5 m r^2
+    invInertia.push_back(1.0 / (0.4 * mass.back() * r * r));
+
+    return size() - 1;
+}
+
+
+void BodyStore::reorder(const SpatialSort& sort)
+{
+    std::vector<double> buffer;
+    std::vector<double>* fields[15] = {&px, &py, &pz, &vx, &vy, &vz, &wx, &wy, &wz,
+                                       &radius, &density, &volume, &mass, &invMass, &invInertia};
+    for (int f = 0; f < 15; f++)
+    {
+        sort.apply(*fields[f], buffer);
+    }
+}
+
+
+BodyArrays BodyStore::getArrays()
+{
+    BodyArrays arrays;
+    arrays.px = px.data(); arrays.py = py.data(); arrays.pz = pz.data();
+    arrays.vx = vx.data(); arrays.vy = vy.data(); arrays.vz = vz.data();
+    arrays.wx = wx.data(); arrays.wy = wy.data(); arrays.wz = wz.data();
+    arrays.radius = radius.data();
+    arrays.volume = volume.data();
+    arrays.invMass = invMass.data();
+    arrays.invInertia = invInertia.data();
+    arrays.count = size();
+
+    return arrays;
+}
+
+
+void BodyStore::step(double delta_t)
+{
+    BodyArrays arrays = getArrays();
+    buoyancy_step(arrays, delta_t);
+}
+
+
+void BodyStore::step(double delta_t, ThreadPool& pool)
+{
+    BodyArrays arrays = getArrays();
+    pool.parallelFor(arrays.count, BODIES_GRAIN, [&arrays, delta_t](int begin, int end)
+    {
+        buoyancy_step(arrays, delta_t, begin, end);
+    });
+}
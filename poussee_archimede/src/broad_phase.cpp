@@ -0,0 +1,385 @@
+#include <cmath>
+#include <algorithm>
+#include "broad_phase.h"
+
+
+int SpatialGrid::hash(int x, int y, int z) const
+{
+    unsigned int h = (unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)z * 83492791u;
+    return (int)(h & (unsigned int)tableMask);
+}
+
+
+void SpatialGrid::computeCells(const BodyArrays& bodies, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        cellX[i] = (int)floor(bodies.px[i] / cellSize);
+        cellY[i] = (int)floor(bodies.py[i] / cellSize);
+        cellZ[i] = (int)floor(bodies.pz[i] / cellSize);
+        bucket[i] = hash(cellX[i], cellY[i], cellZ[i]);
+    }
+}
+
+
+void SpatialGrid::sortBodies(const BodyArrays& bodies)
+{
+    // Counting sort : sizes of the entries, first body of each one, then bodies in index order
+    std::fill(bucketStart.begin(), bucketStart.end(), 0);
+    for (int i = 0; i < bodies.count; i++)
+    {
+        bucketStart[bucket[i] + 1]++;
+    }
+    for (size_t k = 1; k < bucketStart.size(); k++)
+    {
+        bucketStart[k] += bucketStart[k - 1];
+    }
+    std::vector<int> next(bucketStart.begin(), bucketStart.end() - 1);
+    for (int i = 0; i < bodies.count; i++)
+    {
+        int k = next[bucket[i]]++;
+        sorted[k] = i;
+        sortedX[k] = cellX[i];
+        sortedY[k] = cellY[i];
+        sortedZ[k] = cellZ[i];
+        sortedPx[k] = bodies.px[i];
+        sortedPy[k] = bodies.py[i];
+        sortedPz[k] = bodies.pz[i];
+        sortedRadius[k] = bodies.radius[i];
+    }
+}
+
+
+void SpatialGrid::resize(const BodyArrays& bodies)
+{
+    double largest = 0.0;
+    for (int i = 0; i < bodies.count; i++)
+    {
+        largest = std::max(largest, bodies.radius[i]);
+    }
+    cellSize = largest > 0.0 ? 2.0 * largest : 1.0;
+
+    // At least twice as many entries as bodies
+    int tableSize = 1;
+    while (tableSize < 2 * bodies.count)
+    {
+        tableSize *= 2;
+    }
+    tableMask = tableSize - 1;
+    cellX.resize(bodies.count);
+    cellY.resize(bodies.count);
+    cellZ.resize(bodies.count);
+    bucket.resize(bodies.count);
+    bucketStart.resize(tableSize + 1);
+    sorted.resize(bodies.count);
+    sortedX.resize(bodies.count);
+    sortedY.resize(bodies.count);
+    sortedZ.resize(bodies.count);
+    sortedPx.resize(bodies.count);
+    sortedPy.resize(bodies.count);
+    sortedPz.resize(bodies.count);
+    sortedRadius.resize(bodies.count);
+}
+
+
+void SpatialGrid::build(const BodyArrays& bodies)
+{
+    resize(bodies);
+    computeCells(bodies, 0, bodies.count);
+    sortBodies(bodies);
+}
+
+
+void SpatialGrid::build(const BodyArrays& bodies, ThreadPool& pool)
+{
+    resize(bodies);
+    pool.parallelFor(bodies.count, COLLISION_GRAIN, [this, &bodies](int begin, int end)
+    {
+        computeCells(bodies, begin, end);
+    });
+    // A single pass over the bodies, not worth sharing
+    sortBodies(bodies);
+}
+
+
+// Cells after the own one in (z, y, x) order : the other half is searched by the neighbours
+static const int HALF_STENCIL[13][3] = {
+    {1, 0, 0},
+    {-1, 1, 0}, {0, 1, 0}, {1, 1, 0},
+    {-1, -1, 1}, {0, -1, 1}, {1, -1, 1},
+    {-1, 0, 1}, {0, 0, 1}, {1, 0, 1},
+    {-1, 1, 1}, {0, 1, 1}, {1, 1, 1}
+};
+
+
+void SpatialGrid::findPairs(int begin, int end, std::vector<BodyPair>& pairs) const
+{
+    for (int k = begin; k < end; k++)
+    {
+        int i = sorted[k];
+        double x = sortedPx[k], y = sortedPy[k], z = sortedPz[k], r = sortedRadius[k];
+        int entry = bucket[i];
+        for (int s = -1; s < 13; s++)
+        {
+            // Own cell first, the following bodies of the entry only
+            int cx = sortedX[k], cy = sortedY[k], cz = sortedZ[k];
+            int first = k + 1;
+            if (s >= 0)
+            {
+                cx += HALF_STENCIL[s][0];
+                cy += HALF_STENCIL[s][1];
+                cz += HALF_STENCIL[s][2];
+                entry = hash(cx, cy, cz);
+                first = bucketStart[entry];
+            }
+            for (int l = first; l < bucketStart[entry + 1]; l++)
+            {
+                // Other cells sharing the entry are skipped
+                if (sortedX[l] != cx || sortedY[l] != cy || sortedZ[l] != cz)
+                {
+                    continue;
+                }
+                double reach = r + sortedRadius[l];
+                if (fabs(sortedPx[l] - x) < reach && fabs(sortedPy[l] - y) < reach && fabs(sortedPz[l] - z) < reach)
+                {
+                    int j = sorted[l];
+                    pairs.push_back(i < j ? BodyPair(i, j) : BodyPair(j, i));
+                }
+            }
+        }
+    }
+}
+
+
+// Coordinate of the bodies along an axis
+static const double* axis_positions(const BodyArrays& bodies, int axis)
+{
+    return axis == 0 ? bodies.px : (axis == 1 ? bodies.py : bodies.pz);
+}
+
+
+bool SweepAndPrune::chooseAxis(const BodyArrays& bodies)
+{
+    // Extent of the centers along each axis
+    double extent[3] = {0.0, 0.0, 0.0};
+    for (int a = 0; a < 3; a++)
+    {
+        const double* p = axis_positions(bodies, a);
+        double low = 0.0, high = 0.0;
+        for (int i = 0; i < bodies.count; i++)
+        {
+            if (i == 0 || p[i] < low) low = p[i];
+            if (i == 0 || p[i] > high) high = p[i];
+        }
+        extent[a] = high - low;
+    }
+    int widest = 0;
+    for (int a = 1; a < 3; a++)
+    {
+        if (extent[a] > extent[widest])
+        {
+            widest = a;
+        }
+    }
+
+    // Bodies added or removed : the order is lost anyway
+    bool fresh = (int)sorted.size() != bodies.count;
+    // Only a much wider axis is worth a full sort
+    if (fresh || extent[axis] < SWEEP_AXIS_SWITCH * extent[widest])
+    {
+        axis = widest;
+        fresh = true;
+    }
+    return fresh;
+}
+
+
+void SweepAndPrune::computeBounds(const BodyArrays& bodies, int begin, int end)
+{
+    const double* p = axis_positions(bodies, axis);
+    for (int k = begin; k < end; k++)
+    {
+        int i = sorted[k];
+        lower[k] = p[i] - bodies.radius[i];
+        upper[k] = p[i] + bodies.radius[i];
+    }
+}
+
+
+void SweepAndPrune::sortBodies(bool fresh)
+{
+    int n = (int)sorted.size();
+    swaps = 0;
+    if (fresh)
+    {
+        // No order to start from, insertion sort would be quadratic
+        std::vector<int> perm(n);
+        for (int k = 0; k < n; k++)
+        {
+            perm[k] = k;
+        }
+        std::stable_sort(perm.begin(), perm.end(), [this](int k, int l) {return lower[k] < lower[l];});
+        std::vector<int> order(n);
+        std::vector<double> low(n), high(n);
+        for (int k = 0; k < n; k++)
+        {
+            order[k] = sorted[perm[k]];
+            low[k] = lower[perm[k]];
+            high[k] = upper[perm[k]];
+        }
+        sorted.swap(order);
+        lower.swap(low);
+        upper.swap(high);
+        return;
+    }
+
+    // Each body only goes back past the few bodies that overtook it
+    for (int k = 1; k < n; k++)
+    {
+        int i = sorted[k];
+        double low = lower[k], high = upper[k];
+        int l = k;
+        while (l > 0 && lower[l - 1] > low)
+        {
+            sorted[l] = sorted[l - 1];
+            lower[l] = lower[l - 1];
+            upper[l] = upper[l - 1];
+            l--;
+        }
+        sorted[l] = i;
+        lower[l] = low;
+        upper[l] = high;
+        swaps += k - l;
+    }
+}
+
+
+void SweepAndPrune::copyBodies(const BodyArrays& bodies, int begin, int end)
+{
+    for (int k = begin; k < end; k++)
+    {
+        int i = sorted[k];
+        sortedPx[k] = bodies.px[i];
+        sortedPy[k] = bodies.py[i];
+        sortedPz[k] = bodies.pz[i];
+        sortedRadius[k] = bodies.radius[i];
+    }
+}
+
+
+// New order in index order
+static void reset_order(std::vector<int>& sorted, int count)
+{
+    sorted.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        sorted[i] = i;
+    }
+}
+
+
+void SweepAndPrune::build(const BodyArrays& bodies)
+{
+    bool fresh = chooseAxis(bodies);
+    if (fresh)
+    {
+        reset_order(sorted, bodies.count);
+    }
+    lower.resize(bodies.count);
+    upper.resize(bodies.count);
+    computeBounds(bodies, 0, bodies.count);
+    sortBodies(fresh);
+
+    sortedPx.resize(bodies.count);
+    sortedPy.resize(bodies.count);
+    sortedPz.resize(bodies.count);
+    sortedRadius.resize(bodies.count);
+    copyBodies(bodies, 0, bodies.count);
+}
+
+
+void SweepAndPrune::build(const BodyArrays& bodies, ThreadPool& pool)
+{
+    bool fresh = chooseAxis(bodies);
+    if (fresh)
+    {
+        reset_order(sorted, bodies.count);
+    }
+    lower.resize(bodies.count);
+    upper.resize(bodies.count);
+    pool.parallelFor(bodies.count, COLLISION_GRAIN, [this, &bodies](int begin, int end)
+    {
+        computeBounds(bodies, begin, end);
+    });
+    // Every move depends on the previous ones
+    sortBodies(fresh);
+
+    sortedPx.resize(bodies.count);
+    sortedPy.resize(bodies.count);
+    sortedPz.resize(bodies.count);
+    sortedRadius.resize(bodies.count);
+    pool.parallelFor(bodies.count, COLLISION_GRAIN, [this, &bodies](int begin, int end)
+    {
+        copyBodies(bodies, begin, end);
+    });
+}
+
+
+void SweepAndPrune::findPairs(int begin, int end, std::vector<BodyPair>& pairs) const
+{
+    int n = (int)sorted.size();
+    for (int k = begin; k < end; k++)
+    {
+        double x = sortedPx[k], y = sortedPy[k], z = sortedPz[k], r = sortedRadius[k];
+        int i = sorted[k];
+        // Following bodies starting before the end of this one along the axis
+        for (int l = k + 1; l < n && lower[l] < upper[k]; l++)
+        {
+            double reach = r + sortedRadius[l];
+            if (fabs(sortedPx[l] - x) < reach && fabs(sortedPy[l] - y) < reach && fabs(sortedPz[l] - z) < reach)
+            {
+                int j = sorted[l];
+                pairs.push_back(i < j ? BodyPair(i, j) : BodyPair(j, i));
+            }
+        }
+    }
+}
+
+
+void SweepAndPrune::renumber(const std::vector<int>& rank)
+{
+    // The removed bodies leave the order
+    int kept = 0;
+    for (size_t k = 0; k < sorted.size(); k++)
+    {
+        if (rank[sorted[k]] >= 0)
+        {
+            sorted[kept++] = rank[sorted[k]];
+        }
+    }
+    sorted.resize(kept);
+}
+
+
+BroadPhase* create_broad_phase(BroadPhaseType type)
+{
+    switch(type)
+    {
+    case BROADPHASE_SWEEP:
+        return new SweepAndPrune();
+    default:
+        return new SpatialGrid();
+    }
+}
+
+
+const char* broad_phase_name(BroadPhaseType type)
+{
+    switch(type)
+    {
+    case BROADPHASE_SWEEP:
+        return "sweep";
+    default:
+        return "grid";
+    }
+}
@@ -0,0 +1,525 @@
+#include <cmath>
+#include <algorithm>
+#include "bspline.h"
+#include "kernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_X86
+#include <immintrin.h>
+#endif
+
+
+void SurfaceGrid::resize(int cu, int cv)
+{
+    countU = cu;
+    countV = cv;
+    x.assign(cu * cv, 0.0);
+    y.assign(cu * cv, 0.0);
+    z.assign(cu * cv, 0.0);
+    nx.assign(cu * cv, 0.0);
+    ny.assign(cu * cv, 0.0);
+    nz.assign(cu * cv, 0.0);
+}
+
+
+BSplineSurface::BSplineSurface()
+{
+    countU = 0;
+    countV = 0;
+    orderU = 1;
+    orderV = 1;
+}
+
+
+bool BSplineSurface::set(const float *ctrlPoints, int nbPointsU, int nbPointsV,
+                         const float *nodesU, int nbNodesU, const float *nodesV, int nbNodesV)
+{
+    int ordU = nbNodesU - nbPointsU;
+    int ordV = nbNodesV - nbPointsV;
+    if (nbPointsU < 1 || nbPointsV < 1 || ordU < 1 || ordV < 1 ||
+        ordU > nbPointsU || ordV > nbPointsV || ordU > BSPLINE_MAX_ORDER || ordV > BSPLINE_MAX_ORDER)
+    {
+        return false;
+    }
+
+    countU = nbPointsU;
+    countV = nbPointsV;
+    orderU = ordU;
+    orderV = ordV;
+    knotsU.assign(nodesU, nodesU + nbNodesU);
+    knotsV.assign(nodesV, nodesV + nbNodesV);
+    points.resize(countU * countV * 3);
+    setPoints(ctrlPoints);
+
+    return true;
+}
+
+
+void BSplineSurface::setPoints(const float *ctrlPoints)
+{
+    std::copy(ctrlPoints, ctrlPoints + points.size(), points.begin());
+}
+
+
+int BSplineSurface::findSpan(const std::vector<double>& knots, int nbPoints, int order, double t)
+{
+    int degree = order - 1;
+    if (t >= knots[nbPoints])
+    {
+        // Last span which isn't empty
+        int span = nbPoints - 1;
+        while (span > degree && knots[span] == knots[span + 1])
+        {
+            span--;
+        }
+        return span;
+    }
+    if (t <= knots[degree])
+    {
+        return degree;
+    }
+
+    // Binary search of knots[span] <= t < knots[span + 1]
+    int low = degree, high = nbPoints;
+    int span = (low + high) / 2;
+    while (t < knots[span] || t >= knots[span + 1])
+    {
+        if (t < knots[span])
+        {
+            high = span;
+        }
+        else
+        {
+            low = span;
+        }
+        span = (low + high) / 2;
+    }
+    return span;
+}
+
+
+// de Boor's algorithm on the order points d (overwritten) of the span
+// derivative may be NULL
+static void de_boor(const std::vector<double>& knots, int span, int order, double t,
+                    double d[][3], double point[3], double derivative[3])
+{
+    int degree = order - 1;
+    if (derivative != NULL)
+    {
+        derivative[0] = derivative[1] = derivative[2] = 0.0;
+    }
+
+    for (int r = 1; r <= degree; r++)
+    {
+        for (int j = degree; j >= r; j--)
+        {
+            double den = knots[j + 1 + span - r] - knots[j + span - degree];
+            double alpha = den != 0.0 ? (t - knots[j + span - degree]) / den : 0.0;
+            // Last level : the two remaining points give the tangent
+            if (r == degree && derivative != NULL && den != 0.0)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    derivative[c] = degree * (d[j][c] - d[j - 1][c]) / den;
+                }
+            }
+            for (int c = 0; c < 3; c++)
+            {
+                d[j][c] = (1.0 - alpha) * d[j - 1][c] + alpha * d[j][c];
+            }
+        }
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        point[c] = d[degree][c];
+    }
+}
+
+
+Point BSplineSurface::evaluate(double u, double v) const
+{
+    Vector normal;
+    return evaluate(u, v, normal);
+}
+
+
+Point BSplineSurface::evaluate(double u, double v, Vector& normal) const
+{
+    int spanU = findSpan(knotsU, countU, orderU, u);
+    int spanV = findSpan(knotsV, countV, orderV, v);
+    int firstU = spanU - orderU + 1;
+    int firstV = spanV - orderV + 1;
+
+    // Curves along v through the columns of the span, then the curve along u through them
+    double column[BSPLINE_MAX_ORDER][3];
+    double onCurves[BSPLINE_MAX_ORDER][3], alongV[BSPLINE_MAX_ORDER][3];
+    for (int a = 0; a < orderU; a++)
+    {
+        for (int b = 0; b < orderV; b++)
+        {
+            const double *p = &points[((firstV + b) * countU + firstU + a) * 3];
+            column[b][0] = p[0];
+            column[b][1] = p[1];
+            column[b][2] = p[2];
+        }
+        de_boor(knotsV, spanV, orderV, v, column, onCurves[a], alongV[a]);
+    }
+
+    double s[3], su[3], sv[3];
+    de_boor(knotsU, spanU, orderU, u, onCurves, s, su);
+    de_boor(knotsU, spanU, orderU, u, alongV, sv, NULL);
+
+    normal = Vector(sv[0], sv[1], sv[2]) ^ Vector(su[0], su[1], su[2]);
+    double length = normal.norm();
+    normal = length > 0.0 ? (1.0 / length) * normal : Vector(0, 0, 0);
+
+    return Point(s[0], s[1], s[2]);
+}
+
+
+void BSplineSurface::computeBasis(const std::vector<double>& knots, int nbPoints, int order,
+                                  const std::vector<double>& params, Basis& basis) const
+{
+    int degree = order - 1;
+    int count = (int)params.size();
+    basis.order = order;
+    basis.count = count;
+    basis.first.resize(count);
+    basis.values.resize(order * count);
+    basis.derivatives.resize(order * count);
+
+    double n[BSPLINE_MAX_ORDER], lower[BSPLINE_MAX_ORDER];
+    double left[BSPLINE_MAX_ORDER], right[BSPLINE_MAX_ORDER];
+    for (int s = 0; s < count; s++)
+    {
+        double t = params[s];
+        int span = findSpan(knots, nbPoints, order, t);
+
+        // Cox-de Boor recurrence, keeping the functions of degree - 1 for the derivatives
+        n[0] = 1.0;
+        lower[0] = 1.0;
+        for (int j = 1; j <= degree; j++)
+        {
+            if (j == degree)
+            {
+                std::copy(n, n + degree, lower);
+            }
+            left[j] = t - knots[span + 1 - j];
+            right[j] = knots[span + j] - t;
+            double saved = 0.0;
+            for (int r = 0; r < j; r++)
+            {
+                double den = right[r + 1] + left[j - r];
+                double temp = den != 0.0 ? n[r] / den : 0.0;
+                n[r] = saved + right[r + 1] * temp;
+                saved = left[j - r] * temp;
+            }
+            n[j] = saved;
+        }
+
+        basis.first[s] = span - degree;
+        for (int k = 0; k <= degree; k++)
+        {
+            int i = span - degree + k;
+            double derivative = 0.0;
+            if (degree > 0)
+            {
+                double den1 = knots[i + degree] - knots[i];
+                double den2 = knots[i + degree + 1] - knots[i + 1];
+                if (k > 0 && den1 != 0.0)
+                {
+                    derivative += lower[k - 1] / den1;
+                }
+                if (k < degree && den2 != 0.0)
+                {
+                    derivative -= lower[k] / den2;
+                }
+                derivative *= degree;
+            }
+            basis.values[k * count + s] = n[k];
+            basis.derivatives[k * count + s] = derivative;
+        }
+    }
+}
+
+
+void BSplineSurface::evaluateRows(const Basis& basisU, const Basis& basisV, int begin, int end, SurfaceGrid& grid) const
+{
+    int samplesU = basisU.count;
+    int samplesV = basisV.count;
+
+    // Curve along u of each row and its derivative along v
+    std::vector<double> qx(countU), qy(countU), qz(countU);
+    std::vector<double> rx(countU), ry(countU), rz(countU);
+    // Derivatives along u and v of the samples of a row
+    std::vector<double> sux(samplesU), suy(samplesU), suz(samplesU);
+    std::vector<double> svx(samplesU), svy(samplesU), svz(samplesU);
+
+    for (int j = begin; j < end; j++)
+    {
+        int firstV = basisV.first[j];
+        for (int i = 0; i < countU; i++)
+        {
+            qx[i] = qy[i] = qz[i] = 0.0;
+            rx[i] = ry[i] = rz[i] = 0.0;
+            for (int b = 0; b < orderV; b++)
+            {
+                const double *p = &points[((firstV + b) * countU + i) * 3];
+                double w = basisV.values[b * samplesV + j];
+                double dw = basisV.derivatives[b * samplesV + j];
+                qx[i] += w * p[0];
+                qy[i] += w * p[1];
+                qz[i] += w * p[2];
+                rx[i] += dw * p[0];
+                ry[i] += dw * p[1];
+                rz[i] += dw * p[2];
+            }
+        }
+
+        int row = grid.index(0, j);
+        double *x = &grid.x[row], *y = &grid.y[row], *z = &grid.z[row];
+        std::fill(x, x + samplesU, 0.0);
+        std::fill(y, y + samplesU, 0.0);
+        std::fill(z, z + samplesU, 0.0);
+        std::fill(sux.begin(), sux.end(), 0.0);
+        std::fill(suy.begin(), suy.end(), 0.0);
+        std::fill(suz.begin(), suz.end(), 0.0);
+        std::fill(svx.begin(), svx.end(), 0.0);
+        std::fill(svy.begin(), svy.end(), 0.0);
+        std::fill(svz.begin(), svz.end(), 0.0);
+
+        // The samples of a knot span share the same control points :
+        // each one is broadcast over the contiguous weights of the span
+        int s0 = 0;
+        while (s0 < samplesU)
+        {
+            int first = basisU.first[s0];
+            int s1 = s0 + 1;
+            while (s1 < samplesU && basisU.first[s1] == first)
+            {
+                s1++;
+            }
+            for (int k = 0; k < orderU; k++)
+            {
+                int i = first + k;
+                const double *w = &basisU.values[k * samplesU + s0];
+                const double *dw = &basisU.derivatives[k * samplesU + s0];
+                bspline_accumulate(w, qx[i], qy[i], qz[i], x + s0, y + s0, z + s0, s1 - s0);
+                bspline_accumulate(dw, qx[i], qy[i], qz[i], &sux[s0], &suy[s0], &suz[s0], s1 - s0);
+                bspline_accumulate(w, rx[i], ry[i], rz[i], &svx[s0], &svy[s0], &svz[s0], s1 - s0);
+            }
+            s0 = s1;
+        }
+
+        bspline_normals(sux.data(), suy.data(), suz.data(), svx.data(), svy.data(), svz.data(),
+                        &grid.nx[row], &grid.ny[row], &grid.nz[row], samplesU);
+    }
+}
+
+
+// Parameters spread evenly over [min, max]
+static std::vector<double> even_params(double min, double max, int count)
+{
+    std::vector<double> params(count);
+    for (int s = 0; s < count; s++)
+    {
+        params[s] = count > 1 ? min + (max - min) * s / (count - 1) : min;
+    }
+    return params;
+}
+
+
+void BSplineSurface::evaluateGrid(int nbSamplesU, int nbSamplesV, SurfaceGrid& grid) const
+{
+    grid.resize(nbSamplesU, nbSamplesV);
+    if (isEmpty())
+    {
+        return;
+    }
+
+    Basis basisU, basisV;
+    computeBasis(knotsU, countU, orderU, even_params(getMinU(), getMaxU(), nbSamplesU), basisU);
+    computeBasis(knotsV, countV, orderV, even_params(getMinV(), getMaxV(), nbSamplesV), basisV);
+    evaluateRows(basisU, basisV, 0, nbSamplesV, grid);
+}
+
+
+void BSplineSurface::evaluateGrid(int nbSamplesU, int nbSamplesV, SurfaceGrid& grid, ThreadPool& pool) const
+{
+    grid.resize(nbSamplesU, nbSamplesV);
+    if (isEmpty())
+    {
+        return;
+    }
+
+    Basis basisU, basisV;
+    computeBasis(knotsU, countU, orderU, even_params(getMinU(), getMaxU(), nbSamplesU), basisU);
+    computeBasis(knotsV, countV, orderV, even_params(getMinV(), getMaxV(), nbSamplesV), basisV);
+
+    // Each row only writes its own samples
+    pool.parallelFor(nbSamplesV, 8, [this, &basisU, &basisV, &grid](int begin, int end)
+    {
+        evaluateRows(basisU, basisV, begin, end, grid);
+    });
+}
+
+
+static void accumulate_scalar(const double *w, double ax, double ay, double az,
+                              double *outx, double *outy, double *outz, int begin, int n)
+{
+    for (int s = begin; s < n; s++)
+    {
+        outx[s] += w[s] * ax;
+        outy[s] += w[s] * ay;
+        outz[s] += w[s] * az;
+    }
+}
+
+
+static void normals_scalar(const double *ux, const double *uy, const double *uz,
+                           const double *vx, const double *vy, const double *vz,
+                           double *nx, double *ny, double *nz, int begin, int n)
+{
+    for (int s = begin; s < n; s++)
+    {
+        double cx = vy[s] * uz[s] - vz[s] * uy[s];
+        double cy = vz[s] * ux[s] - vx[s] * uz[s];
+        double cz = vx[s] * uy[s] - vy[s] * ux[s];
+        double length = sqrt(cx * cx + cy * cy + cz * cz);
+        double inv = length > 0.0 ? 1.0 / length : 0.0;
+        nx[s] = cx * inv;
+        ny[s] = cy * inv;
+        nz[s] = cz * inv;
+    }
+}
+
+
+#ifdef KERNEL_X86
+
+__attribute__((target("sse2")))
+static void accumulate_sse2(const double *w, double ax, double ay, double az,
+                            double *outx, double *outy, double *outz, int n)
+{
+    const __m128d a1 = _mm_set1_pd(ax), a2 = _mm_set1_pd(ay), a3 = _mm_set1_pd(az);
+    int s = 0;
+    for (; s + 2 <= n; s += 2)
+    {
+        __m128d ws = _mm_loadu_pd(w + s);
+        _mm_storeu_pd(outx + s, _mm_add_pd(_mm_loadu_pd(outx + s), _mm_mul_pd(ws, a1)));
+        _mm_storeu_pd(outy + s, _mm_add_pd(_mm_loadu_pd(outy + s), _mm_mul_pd(ws, a2)));
+        _mm_storeu_pd(outz + s, _mm_add_pd(_mm_loadu_pd(outz + s), _mm_mul_pd(ws, a3)));
+    }
+    accumulate_scalar(w, ax, ay, az, outx, outy, outz, s, n);
+}
+
+
+__attribute__((target("sse2")))
+static void normals_sse2(const double *ux, const double *uy, const double *uz,
+                         const double *vx, const double *vy, const double *vz,
+                         double *nx, double *ny, double *nz, int n)
+{
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d one = _mm_set1_pd(1.0);
+    int s = 0;
+    for (; s + 2 <= n; s += 2)
+    {
+        __m128d ux2 = _mm_loadu_pd(ux + s), uy2 = _mm_loadu_pd(uy + s), uz2 = _mm_loadu_pd(uz + s);
+        __m128d vx2 = _mm_loadu_pd(vx + s), vy2 = _mm_loadu_pd(vy + s), vz2 = _mm_loadu_pd(vz + s);
+        __m128d cx = _mm_sub_pd(_mm_mul_pd(vy2, uz2), _mm_mul_pd(vz2, uy2));
+        __m128d cy = _mm_sub_pd(_mm_mul_pd(vz2, ux2), _mm_mul_pd(vx2, uz2));
+        __m128d cz = _mm_sub_pd(_mm_mul_pd(vx2, uy2), _mm_mul_pd(vy2, ux2));
+        __m128d length = _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(cx, cx), _mm_mul_pd(cy, cy)), _mm_mul_pd(cz, cz)));
+        // 0 instead of 1 / 0 for the degenerated samples
+        __m128d inv = _mm_and_pd(_mm_cmpgt_pd(length, zero), _mm_div_pd(one, length));
+        _mm_storeu_pd(nx + s, _mm_mul_pd(cx, inv));
+        _mm_storeu_pd(ny + s, _mm_mul_pd(cy, inv));
+        _mm_storeu_pd(nz + s, _mm_mul_pd(cz, inv));
+    }
+    normals_scalar(ux, uy, uz, vx, vy, vz, nx, ny, nz, s, n);
+}
+
+
+__attribute__((target("avx2")))
+static void accumulate_avx2(const double *w, double ax, double ay, double az,
+                            double *outx, double *outy, double *outz, int n)
+{
+    const __m256d a1 = _mm256_set1_pd(ax), a2 = _mm256_set1_pd(ay), a3 = _mm256_set1_pd(az);
+    int s = 0;
+    for (; s + 4 <= n; s += 4)
+    {
+        __m256d ws = _mm256_loadu_pd(w + s);
+        _mm256_storeu_pd(outx + s, _mm256_add_pd(_mm256_loadu_pd(outx + s), _mm256_mul_pd(ws, a1)));
+        _mm256_storeu_pd(outy + s, _mm256_add_pd(_mm256_loadu_pd(outy + s), _mm256_mul_pd(ws, a2)));
+        _mm256_storeu_pd(outz + s, _mm256_add_pd(_mm256_loadu_pd(outz + s), _mm256_mul_pd(ws, a3)));
+    }
+    accumulate_scalar(w, ax, ay, az, outx, outy, outz, s, n);
+}
+
+
+__attribute__((target("avx2")))
+static void normals_avx2(const double *ux, const double *uy, const double *uz,
+                         const double *vx, const double *vy, const double *vz,
+                         double *nx, double *ny, double *nz, int n)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    int s = 0;
+    for (; s + 4 <= n; s += 4)
+    {
+        __m256d ux4 = _mm256_loadu_pd(ux + s), uy4 = _mm256_loadu_pd(uy + s), uz4 = _mm256_loadu_pd(uz + s);
+        __m256d vx4 = _mm256_loadu_pd(vx + s), vy4 = _mm256_loadu_pd(vy + s), vz4 = _mm256_loadu_pd(vz + s);
+        __m256d cx = _mm256_sub_pd(_mm256_mul_pd(vy4, uz4), _mm256_mul_pd(vz4, uy4));
+        __m256d cy = _mm256_sub_pd(_mm256_mul_pd(vz4, ux4), _mm256_mul_pd(vx4, uz4));
+        __m256d cz = _mm256_sub_pd(_mm256_mul_pd(vx4, uy4), _mm256_mul_pd(vy4, ux4));
+        __m256d length = _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(cx, cx), _mm256_mul_pd(cy, cy)), _mm256_mul_pd(cz, cz)));
+        __m256d inv = _mm256_and_pd(_mm256_cmp_pd(length, zero, _CMP_GT_OQ), _mm256_div_pd(one, length));
+        _mm256_storeu_pd(nx + s, _mm256_mul_pd(cx, inv));
+        _mm256_storeu_pd(ny + s, _mm256_mul_pd(cy, inv));
+        _mm256_storeu_pd(nz + s, _mm256_mul_pd(cz, inv));
+    }
+    normals_scalar(ux, uy, uz, vx, vy, vz, nx, ny, nz, s, n);
+}
+
+#endif
+
+
+void bspline_accumulate(const double *w, double ax, double ay, double az,
+                        double *outx, double *outy, double *outz, int n)
+{
+#ifdef KERNEL_X86
+    switch(get_kernel_level())
+    {
+    case KERNEL_AVX2:
+        accumulate_avx2(w, ax, ay, az, outx, outy, outz, n);
+        return;
+    case KERNEL_SSE2:
+        accumulate_sse2(w, ax, ay, az, outx, outy, outz, n);
+        return;
+    default:
+        break;
+    }
+#endif
+    accumulate_scalar(w, ax, ay, az, outx, outy, outz, 0, n);
+}
+
+
+void bspline_normals(const double *ux, const double *uy, const double *uz,
+                     const double *vx, const double *vy, const double *vz,
+                     double *nx, double *ny, double *nz, int n)
+{
+#ifdef KERNEL_X86
+    switch(get_kernel_level())
+    {
+    case KERNEL_AVX2:
+        normals_avx2(ux, uy, uz, vx, vy, vz, nx, ny, nz, n);
+        return;
+    case KERNEL_SSE2:
+        normals_sse2(ux, uy, uz, vx, vy, vz, nx, ny, nz, n);
+        return;
+    default:
+        break;
+    }
+#endif
+    normals_scalar(ux, uy, uz, vx, vy, vz, nx, ny, nz, 0, n);
+}
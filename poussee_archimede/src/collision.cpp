@@ -0,0 +1,494 @@
+#include <cmath>
+#include <algorithm>
+#include "collision.h"
+
+
+Wall::Wall(Point o, Vector v1, Vector v2, double l, double w, Point inside, double rest, double fric)
+{
+    org = o;
+    u = 1.0 / v1.norm() * v1;
+    v = 1.0 / v2.norm() * v2;
+    length = l;
+    width = w;
+    normal = u ^ v;
+    normal = 1.0 / normal.norm() * normal;
+    if (distance(inside) < 0.0)
+    {
+        normal = -normal;
+    }
+    restitution = rest;
+    friction = fric;
+}
+
+
+CollisionSystem::CollisionSystem(BroadPhaseType type)
+{
+    broadPhase = create_broad_phase(type);
+    pairContacts = 0;
+    cachePairContacts = 0;
+    iterations = CONTACT_ITERATIONS;
+    warmStarting = true;
+}
+
+
+void CollisionSystem::setBroadPhase(BroadPhaseType type)
+{
+    delete broadPhase;
+    broadPhase = create_broad_phase(type);
+}
+
+
+void CollisionSystem::collidePairs(const BodyArrays& bodies, int begin, int end, std::vector<Contact>& found) const
+{
+    for (int k = begin; k < end; k++)
+    {
+        int a = pairs[k].a, b = pairs[k].b;
+        Vector d(bodies.px[a] - bodies.px[b], bodies.py[a] - bodies.py[b], bodies.pz[a] - bodies.pz[b]);
+        double reach = bodies.radius[a] + bodies.radius[b];
+        double distance2 = d * d;
+        if (distance2 >= reach * reach)
+        {
+            continue;
+        }
+
+        Contact c;
+        c.a = a;
+        c.b = b;
+        double distance = sqrt(distance2);
+        // Same centers : pushed apart vertically
+        c.normal = distance > 0.0 ? 1.0 / distance * d : Vector(0, 1, 0);
+        c.depth = reach - distance;
+        c.restitution = CONTACT_RESTITUTION;
+        c.friction = CONTACT_FRICTION;
+        found.push_back(c);
+    }
+}
+
+
+void CollisionSystem::collideWalls(const BodyArrays& bodies, int begin, int end, std::vector<Contact>& found) const
+{
+    for (int i = begin; i < end; i++)
+    {
+        Point center(bodies.px[i], bodies.py[i], bodies.pz[i]);
+        double r = bodies.radius[i];
+        for (size_t w = 0; w < walls.size(); w++)
+        {
+            const Wall& wall = walls[w];
+            Vector d(wall.org, center);
+            double s = d * wall.normal;
+            if (s >= r || s <= -r)
+            {
+                continue;
+            }
+
+            // Closest point of the rectangle, from its origin
+            double a = d * wall.u, b = d * wall.v;
+            double ca = std::min(std::max(a, 0.0), wall.length);
+            double cb = std::min(std::max(b, 0.0), wall.width);
+            Contact c;
+            if (s >= 0.0)
+            {
+                // In front : face, edge or corner
+                Vector e = d - ca * wall.u - cb * wall.v;
+                double distance2 = e * e;
+                if (distance2 >= r * r)
+                {
+                    continue;
+                }
+                double distance = sqrt(distance2);
+                c.normal = distance > 0.0 ? 1.0 / distance * e : wall.normal;
+                c.depth = r - distance;
+            }
+            else
+            {
+                // Behind : only over the face, the bodies passing around the edges are left alone
+                if (a != ca || b != cb)
+                {
+                    continue;
+                }
+                c.normal = wall.normal;
+                c.depth = r - s;
+            }
+            c.a = i;
+            c.b = -1 - (int)w;
+            c.restitution = wall.restitution;
+            c.friction = wall.friction;
+            found.push_back(c);
+        }
+    }
+}
+
+
+void CollisionSystem::sortPairs(int count)
+{
+    // Counting sort on a, then each (short) list of a on b
+    std::vector<int> start(count + 1, 0);
+    for (size_t k = 0; k < pairs.size(); k++)
+    {
+        start[pairs[k].a + 1]++;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        start[i + 1] += start[i];
+    }
+    std::vector<BodyPair> sorted(pairs.size());
+    std::vector<int> next(start.begin(), start.end() - 1);
+    for (size_t k = 0; k < pairs.size(); k++)
+    {
+        sorted[next[pairs[k].a]++] = pairs[k];
+    }
+    for (int i = 0; i < count; i++)
+    {
+        std::sort(sorted.begin() + start[i], sorted.begin() + start[i + 1],
+                  [](const BodyPair& p, const BodyPair& q) {return p.b < q.b;});
+    }
+    pairs.swap(sorted);
+}
+
+
+// Order of the contacts in each part of the list : body a, then body b or wall
+static long long contact_key(const Contact& c)
+{
+    return ((long long)c.a << 32) | (long long)(c.b >= 0 ? c.b : -1 - c.b);
+}
+
+
+// Marks the contacts [begin, end[ found in the cached contacts [first, last[, both in key order,
+// and takes their impulses if asked
+static void match_contacts(const std::vector<Contact>& cache, int first, int last,
+                           std::vector<Contact>& contacts, int begin, int end, bool impulses)
+{
+    int l = first;
+    for (int k = begin; k < end; k++)
+    {
+        long long key = contact_key(contacts[k]);
+        while (l < last && contact_key(cache[l]) < key)
+        {
+            l++;
+        }
+        if (l < last && contact_key(cache[l]) == key)
+        {
+            contacts[k].persistent = true;
+            // The impulse of an impact stopped a fall, not a weight : started again from zero
+            if (impulses && cache[l].approach >= -RESTITUTION_THRESHOLD)
+            {
+                contacts[k].normalImpulse = cache[l].normalImpulse;
+                contacts[k].tangentImpulse = cache[l].tangentImpulse;
+            }
+        }
+    }
+}
+
+
+void CollisionSystem::renumber(const std::vector<int>& rank)
+{
+    // Contacts of the removed bodies dropped
+    int kept = 0, keptPairs = 0;
+    for (size_t k = 0; k < contacts.size(); k++)
+    {
+        Contact c = contacts[k];
+        if (rank[c.a] < 0 || (c.b >= 0 && rank[c.b] < 0))
+        {
+            continue;
+        }
+        c.a = rank[c.a];
+        if (c.b >= 0)
+        {
+            c.b = rank[c.b];
+            // Pairs keep a < b : seen from the other body
+            if (c.a > c.b)
+            {
+                std::swap(c.a, c.b);
+                c.normal = -c.normal;
+                c.tangentImpulse = -c.tangentImpulse;
+            }
+        }
+        if ((int)k < pairContacts)
+        {
+            keptPairs++;
+        }
+        contacts[kept++] = c;
+    }
+    contacts.resize(kept);
+    pairContacts = keptPairs;
+    // Back in key order in each part of the list
+    std::vector<Contact>::iterator middle = contacts.begin() + pairContacts;
+    std::sort(contacts.begin(), middle, [](const Contact& p, const Contact& q) {return contact_key(p) < contact_key(q);});
+    std::sort(middle, contacts.end(), [](const Contact& p, const Contact& q) {return contact_key(p) < contact_key(q);});
+    broadPhase->renumber(rank);
+}
+
+
+void CollisionSystem::renumberBodies(const std::vector<int>& rank)
+{
+    applyRenumbering();
+    renumber(rank);
+}
+
+
+void CollisionSystem::moveBody(int from, int to)
+{
+    int known = (int)origin.size();
+    int body = from < known ? origin[from] : -1;
+    if (body >= 0)
+    {
+        rank[body] = to;
+        touched.push_back(body);
+    }
+    if (to < known)
+    {
+        origin[to] = body;
+        touched.push_back(to);
+    }
+    if (from < known)
+    {
+        origin[from] = -1;
+        touched.push_back(from);
+    }
+}
+
+
+void CollisionSystem::dropBody(int i)
+{
+    int known = (int)origin.size();
+    int body = i < known ? origin[i] : -1;
+    if (body >= 0)
+    {
+        rank[body] = -1;
+        touched.push_back(body);
+    }
+    if (i < known)
+    {
+        origin[i] = -1;
+        touched.push_back(i);
+    }
+}
+
+
+void CollisionSystem::applyRenumbering()
+{
+    if (touched.empty())
+    {
+        return;
+    }
+    renumber(rank);
+    for (size_t k = 0; k < touched.size(); k++)
+    {
+        rank[touched[k]] = touched[k];
+        origin[touched[k]] = touched[k];
+    }
+    touched.clear();
+}
+
+
+void CollisionSystem::resetNumbering(int count)
+{
+    // Identity on the entries kept, the new bodies added
+    int known = (int)rank.size();
+    rank.resize(count);
+    origin.resize(count);
+    for (int i = known; i < count; i++)
+    {
+        rank[i] = i;
+        origin[i] = i;
+    }
+}
+
+
+void CollisionSystem::warmStart()
+{
+    match_contacts(cache, 0, cachePairContacts, contacts, 0, pairContacts, warmStarting);
+    match_contacts(cache, cachePairContacts, (int)cache.size(), contacts, pairContacts, (int)contacts.size(), warmStarting);
+}
+
+
+// Speed of the contact point of body a relative to the one of body b (at rest if b < 0)
+// The contact points are at r a = -radius a n and r b = radius b n from the centers
+static Vector relative_speed(const BodyArrays& bodies, const Contact& c)
+{
+    int a = c.a, b = c.b;
+    Vector ra = -bodies.radius[a] * c.normal;
+    Vector speed = Vector(bodies.vx[a], bodies.vy[a], bodies.vz[a])
+                 + (Vector(bodies.wx[a], bodies.wy[a], bodies.wz[a]) ^ ra);
+    if (b >= 0)
+    {
+        Vector rb = bodies.radius[b] * c.normal;
+        speed = speed - Vector(bodies.vx[b], bodies.vy[b], bodies.vz[b])
+                      - (Vector(bodies.wx[b], bodies.wy[b], bodies.wz[b]) ^ rb);
+    }
+    return speed;
+}
+
+
+// Impulse on the contact point of body a, the opposite one on body b
+// Only the tangential part turns the spheres, the normal one goes through their centers
+static void apply_impulse(BodyArrays& bodies, const Contact& c, const Vector& impulse)
+{
+    int a = c.a, b = c.b;
+    double invA = bodies.invMass[a];
+    Vector turnA = (bodies.invInertia[a] * -bodies.radius[a]) * (c.normal ^ impulse);
+    bodies.vx[a] += invA * impulse.x;
+    bodies.vy[a] += invA * impulse.y;
+    bodies.vz[a] += invA * impulse.z;
+    bodies.wx[a] += turnA.x;
+    bodies.wy[a] += turnA.y;
+    bodies.wz[a] += turnA.z;
+    if (b >= 0)
+    {
+        double invB = bodies.invMass[b];
+        Vector turnB = (bodies.invInertia[b] * bodies.radius[b]) * (c.normal ^ impulse);
+        bodies.vx[b] -= invB * impulse.x;
+        bodies.vy[b] -= invB * impulse.y;
+        bodies.vz[b] -= invB * impulse.z;
+        bodies.wx[b] -= turnB.x;
+        bodies.wy[b] -= turnB.y;
+        bodies.wz[b] -= turnB.z;
+    }
+}
+
+
+void CollisionSystem::solve(BodyArrays& bodies)
+{
+    // Bounces from the speeds before any impulse
+    for (size_t k = 0; k < contacts.size(); k++)
+    {
+        Contact& c = contacts[k];
+        c.approach = relative_speed(bodies, c) * c.normal;
+        c.target = !c.persistent && c.approach < -RESTITUTION_THRESHOLD ? -c.restitution * c.approach : 0.0;
+    }
+    // Impulses of the previous step
+    for (size_t k = 0; k < contacts.size(); k++)
+    {
+        Contact& c = contacts[k];
+        // The normal turned a little since the previous step
+        c.tangentImpulse = c.tangentImpulse - (c.tangentImpulse * c.normal) * c.normal;
+        apply_impulse(bodies, c, c.normalImpulse * c.normal + c.tangentImpulse);
+    }
+
+    // Each impulse is corrected by what the others changed, within its limits :
+    // pushing only, friction within the Coulomb cone
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+        for (size_t k = 0; k < contacts.size(); k++)
+        {
+            Contact& c = contacts[k];
+            const Vector& n = c.normal;
+            double invSum = bodies.invMass[c.a] + (c.b >= 0 ? bodies.invMass[c.b] : 0.0);
+            // Along the contact plane the impulse also turns the spheres : r^2 / I more
+            double ra = bodies.radius[c.a];
+            double invTangent = invSum + bodies.invInertia[c.a] * ra * ra;
+            if (c.b >= 0)
+            {
+                double rb = bodies.radius[c.b];
+                invTangent += bodies.invInertia[c.b] * rb * rb;
+            }
+
+            double vn = relative_speed(bodies, c) * n;
+            double normalImpulse = std::max(c.normalImpulse - (vn - c.target) / invSum, 0.0);
+            apply_impulse(bodies, c, (normalImpulse - c.normalImpulse) * n);
+            c.normalImpulse = normalImpulse;
+
+            Vector relative = relative_speed(bodies, c);
+            Vector sliding = relative - (relative * n) * n;
+            Vector tangentImpulse = c.tangentImpulse - 1.0 / invTangent * sliding;
+            double limit = c.friction * c.normalImpulse;
+            double norm = tangentImpulse.norm();
+            if (norm > limit)
+            {
+                tangentImpulse = limit / norm * tangentImpulse;
+            }
+            apply_impulse(bodies, c, tangentImpulse - c.tangentImpulse);
+            c.tangentImpulse = tangentImpulse;
+        }
+    }
+
+    // Overlap shared according to the masses, the speeds are left alone
+    for (size_t k = 0; k < contacts.size(); k++)
+    {
+        const Contact& c = contacts[k];
+        int a = c.a, b = c.b;
+        double invA = bodies.invMass[a];
+        double invB = b >= 0 ? bodies.invMass[b] : 0.0;
+        const Vector& n = c.normal;
+        double push = CONTACT_CORRECTION * c.depth / (invA + invB);
+
+        bodies.px[a] += push * invA * n.x;
+        bodies.py[a] += push * invA * n.y;
+        bodies.pz[a] += push * invA * n.z;
+        if (b >= 0)
+        {
+            bodies.px[b] -= push * invB * n.x;
+            bodies.py[b] -= push * invB * n.y;
+            bodies.pz[b] -= push * invB * n.z;
+        }
+    }
+}
+
+
+void CollisionSystem::step(BodyArrays& bodies)
+{
+    applyRenumbering();
+    broadPhase->build(bodies);
+    pairs.clear();
+    broadPhase->findPairs(0, broadPhase->size(), pairs);
+    sortPairs(bodies.count);
+
+    // The contacts of the previous step become the cache
+    cache.swap(contacts);
+    cachePairContacts = pairContacts;
+    contacts.clear();
+    collidePairs(bodies, 0, (int)pairs.size(), contacts);
+    pairContacts = (int)contacts.size();
+    collideWalls(bodies, 0, bodies.count, contacts);
+    warmStart();
+    solve(bodies);
+    resetNumbering(bodies.count);
+}
+
+
+// Runs fn on the chunks of [0, count[, the items of each chunk in their own list,
+// then appends the lists in chunk order
+template <class T, class F>
+static void gather_chunks(ThreadPool& pool, int count, std::vector<T>& result, F fn)
+{
+    int chunk = pool.chunkSize(count, COLLISION_GRAIN);
+    std::vector<std::vector<T> > found((count + chunk - 1) / chunk);
+    pool.parallelFor(count, COLLISION_GRAIN, [chunk, &found, &fn](int begin, int end)
+    {
+        fn(begin, end, found[begin / chunk]);
+    });
+    for (size_t c = 0; c < found.size(); c++)
+    {
+        result.insert(result.end(), found[c].begin(), found[c].end());
+    }
+}
+
+
+void CollisionSystem::step(BodyArrays& bodies, ThreadPool& pool)
+{
+    applyRenumbering();
+    broadPhase->build(bodies, pool);
+    pairs.clear();
+    gather_chunks(pool, broadPhase->size(), pairs, [this](int begin, int end, std::vector<BodyPair>& found)
+    {
+        broadPhase->findPairs(begin, end, found);
+    });
+    sortPairs(bodies.count);
+
+    cache.swap(contacts);
+    cachePairContacts = pairContacts;
+    contacts.clear();
+    gather_chunks(pool, (int)pairs.size(), contacts, [this, &bodies](int begin, int end, std::vector<Contact>& found)
+    {
+        collidePairs(bodies, begin, end, found);
+    });
+    pairContacts = (int)contacts.size();
+    gather_chunks(pool, bodies.count, contacts, [this, &bodies](int begin, int end, std::vector<Contact>& found)
+    {
+        collideWalls(bodies, begin, end, found);
+    });
+    // Each contact changes the bodies of the next ones
+    warmStart();
+    solve(bodies);
+    resetNumbering(bodies.count);
+}
@@ -1,6 +1,7 @@
 // Using SDL, SDL OpenGL and standard IO
 #include <iostream>
 #include <cmath>
+#include <cstring>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
 #include <GL/GLU.h>
@@ -9,6 +10,21 @@
 #include "geometry.h"
 // Module for generating and rendering forms
 #include "forms.h"
+// Module for creating and updating the simulation
+#include "scene.h"
+// Module for fixed time step scheduling
+#include "timestep.h"
+// Module for parallel loops
+#include "thread_pool.h"
+// Module for OpenGL functions loading
+#include "gl_ext.h"
+// Module for meshes and levels of detail
+#include "mesh.h"
+// Module for batched rendering of spheres
+#include "batch.h"
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
 
 /***************************************************************************/
@@ -18,12 +34,18 @@
 const int SCREEN_WIDTH = 950;
 const int SCREEN_HEIGHT = 750;
 
-// Max number of forms : static allocation
-const int MAX_FORMS_NUMBER = 11;
+// Vertical field of view (in degrees)
+const double FIELD_OF_VIEW = 40.0;
 
 // Animation actualization delay (in ms) => 100 updates per second
 const Uint32 ANIM_DELAY = 10;
 
+// Max number of physics steps for one rendered frame
+const int MAX_SUBSTEPS = 10;
+
+// Longer frames (in s) are not fully simulated
+const double MAX_FRAME_TIME = 0.25;
+
 
 // Starts up SDL, creates window, and initializes OpenGL
 bool init(SDL_Window** window, SDL_GLContext* context);
@@ -31,11 +53,9 @@ bool init(SDL_Window** window, SDL_GLContext* context);
 // Initializes matrices and clear color
 bool initGL();
 
-// Updating forms for animation
-void update(Form* formlist[MAX_FORMS_NUMBER], double delta_t);
-
 // Renders scene to the screen
-void render(Form* formlist[MAX_FORMS_NUMBER], const Point &cam_pos);
+// The spheres and the cube faces are gathered in batches and drawn together
+void render(Scene& scene, const Point &cam_pos, double deg, SphereBatch& spheres, FaceBatch& faces);
 
 // Frees media and shuts down SDL
 void close(SDL_Window** window);
@@ -86,6 +106,12 @@ bool init(SDL_Window** window, SDL_GLContext* context)
                     std::cout << "Warning: Unable to set VSync! SDL Error: " << SDL_GetError() << std::endl;
                 }
 
+                // Load OpenGL functions newer than 1.1
+                if( !load_gl_extensions(SDL_GL_GetProcAddress) )
+                {
+                    std::cout << "Warning: Vertex buffers not supported, using vertex arrays" << std::endl;
+                }
+
                 // Initialize OpenGL
                 if( !initGL() )
                 {
@@ -113,7 +139,7 @@ bool initGL()
     glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
 
     // Fix aspect ratio and depth clipping planes
-    gluPerspective(40.0, (GLdouble)SCREEN_WIDTH/SCREEN_HEIGHT, 1.0, 100.0);
+    gluPerspective(FIELD_OF_VIEW, (GLdouble)SCREEN_WIDTH/SCREEN_HEIGHT, 1.0, 100.0);
 
 
     // Initialize Modelview Matrix
@@ -167,18 +193,7 @@ bool initGL()
     return success;
 }
 
-void update(Form* formlist[MAX_FORMS_NUMBER], double delta_t)
-{
-    // Update the list of forms
-    unsigned short i = 0;
-    while(formlist[i] != NULL)
-    {
-        formlist[i]->update(delta_t);
-        i++;
-    }
-}
-
-void render(Form* formlist[MAX_FORMS_NUMBER], const Point &cam_pos, double deg)
+void render(Scene& scene, const Point &cam_pos, double deg, SphereBatch& spheres, FaceBatch& faces)
 {
     // Clear color buffer and Z-Buffer
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -194,6 +209,12 @@ void render(Form* formlist[MAX_FORMS_NUMBER], const Point &cam_pos, double deg)
                     0.0f, 1.0f,  0.0f);
     // Isometric view
     glRotated(deg, 0, 1, 0);
+
+    // Camera position in the rotated world, for the levels of detail
+    double agl = -deg * M_PI / 180.0;
+    Point eye(cam_pos.x * cos(agl) + cam_pos.z * sin(agl), cam_pos.y,
+              -cam_pos.x * sin(agl) + cam_pos.z * cos(agl));
+    set_lod_view(eye, FIELD_OF_VIEW, SCREEN_HEIGHT);
 //    glRotated(30, 1, 0, -1);
 
     // X, Y and Z axis
@@ -214,15 +235,39 @@ void render(Form* formlist[MAX_FORMS_NUMBER], const Point &cam_pos, double deg)
     glEnd();
     glPopMatrix(); // Restore the camera viewing point for next object
 
-    // Render the list of forms
-    unsigned short i = 0;
-    while(formlist[i] != NULL)
+    // The cube faces don't move : gathered only once
+    if (faces.isEmpty())
+    {
+        for (size_t i = 0; i < scene.getFaces().size(); i++)
+        {
+            faces.add(*scene.getFaces()[i]);
+        }
+    }
+
+    // Opaque forms first : spheres, one draw call per level of detail, and faces
+    for (size_t i = 0; i < scene.getSpheres().size(); i++)
+    {
+        spheres.add(*scene.getSpheres()[i]);
+    }
+    spheres.draw();
+    faces.drawOpaque();
+
+    // Render the water : surfaces and fluids
+    for (size_t i = 0; i < scene.getSurfaces().size(); i++)
     {
         glPushMatrix(); // Preserve the camera viewing point for further forms
-        formlist[i]->render();
+        scene.getSurfaces()[i]->render();
         glPopMatrix(); // Restore the camera viewing point for next object
-        i++;
     }
+    for (size_t i = 0; i < scene.getFluids().size(); i++)
+    {
+        glPushMatrix();
+        scene.getFluids()[i]->render();
+        glPopMatrix();
+    }
+
+    // Transparent faces last, from back to front
+    faces.drawTransparent(eye);
 }
 
 void close(SDL_Window** window)
@@ -287,126 +332,21 @@ int main(int argc, char* args[])
         Point camera_position(xcam, ycam, zcam);
 
         // The forms to render
-        Form* forms_list[MAX_FORMS_NUMBER];
-        unsigned short number_of_forms = 0, i;
-        for (i=0; i<MAX_FORMS_NUMBER; i++)
-        {
-            forms_list[i] = NULL;
-        }
-
-        // Create here specific forms and add them to the list...
-        // Don't forget to update the actual number_of_forms !
-          Cube_face *pFace = NULL;
-//        pFace = new Cube_face(Vector(1,0,0), Vector(0,1,0), Point(-0.5, -0.5, -0.5), 1, 1, ORANGE);
-//        forms_list[number_of_forms] = pFace;
-//        number_of_forms++;
-//
-//        Cube_face *pFace2 = NULL;
-//        pFace2 = new Cube_face(Vector(0,1,0), Vector(0,0,1), Point(-0.5, -0.5, -0.5), 1, 1, BLUE);
-//        forms_list[number_of_forms] = pFace2;
-//        number_of_forms++;
-//
-//        Cube_face *pFace3 = NULL;
-//        pFace3 = new Cube_face(Vector(1,0,0), Vector(0,0,1), Point(-0.5, -0.5, -0.5), 1, 1, RED);
-//        forms_list[number_of_forms] = pFace3;
-//        number_of_forms++;
-//
-//        Cube_face *pFace4 = NULL;
-//        pFace4 = new Cube_face(Vector(0,-1,0), Vector(0,0,-1), Point(0.5, 0.5, 0.5), 1, 1, GREEN);
-//        forms_list[number_of_forms] = pFace4;
-//        number_of_forms++;
-//
-//        Cube_face *pFace5 = NULL;
-//        pFace5 = new Cube_face(Vector(-1,0,0), Vector(0,0,-1), Point(0.5, 0.5, 0.5), 1, 1, WHITE);
-//        forms_list[number_of_forms] = pFace5;
-//        number_of_forms++;
-//
-//        Cube_face *pFace6 = NULL;
-//        pFace6 = new Cube_face(Vector(-1,0,0), Vector(0,-1,0), Point(0.5, 0.5, 0.5), 1, 1, YELLOW);
-//        forms_list[number_of_forms] = pFace6;
-//        number_of_forms++;
-
-        // Cube_face *pFace = NULL;
-        // pFace = new Cube_face(Vector(1,0,0), Vector(0,1,0), Point(0.5, 0, 0.5), 1, 1, ORANGE);
-        // forms_list[number_of_forms] = pFace;
-        // number_of_forms++;
-
-//        Sphere *pSphere1 = NULL;
-//        pSphere1 = new Sphere(1, BLUE);
-//        forms_list[number_of_forms] = pSphere1;
-//        number_of_forms++;
+        Scene scene;
+        // Waves on the water surface, or SPH particles when started with the "particles" argument
+        WaterModel water = argc > 1 && strcmp(args[1], "particles") == 0 ? WATER_PARTICLES : WATER_WAVES;
+        create_scene(scene, INTEGRATOR_EULER, BROADPHASE_GRID, water);
         glEnable(GL_BLEND);
 
-        double agr = 1;
-        // arrière
-        pFace = new Cube_face(Vector(1,0,0), Vector(0,1,0), Point(-0.5*agr, -0.5*agr, -0.5*agr), 1*agr, 1.2*agr, WHITE);
-        forms_list[number_of_forms] = pFace;
-        number_of_forms++;
-         //coté gauche
-        pFace = new Cube_face(Vector(0,0,1), Vector(0,1,0), Point(-0.5*agr, -0.5*agr, -0.5*agr), 1*agr, 1.2*agr, WHITE);
-        forms_list[number_of_forms] = pFace;
-        number_of_forms++;
-        // sol
-        pFace = new Cube_face(Vector(1,0,0), Vector(0,0,1), Point(-0.5*agr, -0.5*agr, -0.5*agr), 1*agr, 1*agr, BLACK);
-        forms_list[number_of_forms] = pFace;
-        number_of_forms++;
-        // coté droit
-        pFace = new Cube_face(Vector(0,0,1), Vector(0,1,0), Point(0.5*agr, -0.5*agr, -0.5*agr), 1*agr, 1.2*agr, WHITE);
-        forms_list[number_of_forms] = pFace;
-        number_of_forms++;
-
-         // Création de deux sphères
-        Sphere* sphere1 = new Sphere(0.2, ORANGE); // Réduction de moitié du rayon
-        sphere1->getAnim().setPos(Point(-0.5, 6, -0.5));
-        //sphere1->getAnim().setPos(Point(0.5, 0.5, 0.5));
-        forms_list[number_of_forms] = sphere1;
-        number_of_forms++;
-
-
-//         // coté HAUT pour l'eau
-        pFace = new Cube_face(Vector(1,0,0), Vector(0,0,1), Point(-0.5*agr, 0.5*agr, -0.5*agr), 1*agr, 1*agr,DARK_BLUE_TRANSPARENT);
-        forms_list[number_of_forms] = pFace;
-        number_of_forms++;
-         // AVANT POUR L'eau
-        pFace = new Cube_face(Vector(1,0,0), Vector(0,1,0), Point(-0.5*agr, -0.5*agr, 0.5*agr), 1*agr, 1*agr, WATER_TRANSPARENT);
-        forms_list[number_of_forms] = pFace;
-        number_of_forms++;
-
-
-
-
-
-
-
-        int nbPtsCtrlX = 6;
-        int nbPtsCtrlZ = 6;
-
-        GLfloat *ctrlPoints = new GLfloat[nbPtsCtrlX*nbPtsCtrlZ*3];
-
-        GLfloat d = 0;
-        for (int i = 0; i < nbPtsCtrlX; i++) {
-            GLfloat c = 0;
-            for (int j = 0; j < nbPtsCtrlZ; j++) {
-                ctrlPoints[(i*6*3)+j*3+0] = c;
-                ctrlPoints[(i*6*3)+j*3+1] = 0;
-                ctrlPoints[(i*6*3)+j*3+2] = d;
-                c++;
-            }
-            d++;
-        }
-
-        ctrlPoints[(3*6*3)+3*3+1] = 10;
-
-//    std::cout<<"ctrlPoints : \n";
-//    for (int i = 0; i < 108; i++) {
-//        std::cout<<i<<" -> "<<ctrlPoints[i]<<"\n";
-//    }
+        // Spheres and cube faces rendering
+        SphereBatch sphere_batch;
+        FaceBatch face_batch;
 
+        // Physics run at a fixed time step, whatever the frame rate
+        FixedTimeStep time_step(1e-3 * ANIM_DELAY, MAX_SUBSTEPS, MAX_FRAME_TIME);
 
-//        Surface *pSurface = NULL;
-//        pSurface = new Surface(ctrlPoints, nbPtsCtrlX, nbPtsCtrlZ);
-//        forms_list[number_of_forms] = pSurface;
-//        number_of_forms++;
+        // Physics threads, the main thread also handles events and rendering
+        ThreadPool pool;
 
         // Get first "current time"
         previous_time = SDL_GetTicks();
@@ -529,15 +469,18 @@ int main(int argc, char* args[])
             // Update the scene
             current_time = SDL_GetTicks(); // get the elapsed time from SDL initialization (ms)
             elapsed_time = current_time - previous_time;
-            if (elapsed_time > ANIM_DELAY)
+            previous_time = current_time;
+            int steps = time_step.advance(1e-3 * elapsed_time); // International system units : seconds
+            for (int n = 0; n < steps; n++)
             {
-                previous_time = current_time;
-                update(forms_list, 1e-3 * elapsed_time); // International system units : seconds
+                update(scene, time_step.getStep(), pool);
             }
+            // Rendering state between the two last physics steps
+            interpolate(scene, time_step.getAlpha());
 
             // Render the scene
              camera_position = Point(xcam, ycam, zcam);
-             render(forms_list, camera_position, rho);
+             render(scene, camera_position, rho, sphere_batch, face_batch);
 
 
             // Update window screen
@@ -0,0 +1,75 @@
+#include "form_pool.h"
+
+
+FormHandle FormArena::addSlot(Form *form, FormType type)
+{
+    int index;
+    if (!freeSlots.empty())
+    {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        index = (int)slots.size();
+        Slot slot;
+        slot.generation = 0;
+        slots.push_back(slot);
+    }
+    slots[index].form = form;
+    slots[index].type = type;
+    count++;
+    return FormHandle(index, slots[index].generation);
+}
+
+
+void FormArena::destroyForm(Slot& slot)
+{
+    switch (slot.type)
+    {
+    case FORM_SPHERE:
+        spheres.destroy(static_cast<Sphere*>(slot.form));
+        break;
+    case FORM_CUBE_FACE:
+        faces.destroy(static_cast<Cube_face*>(slot.form));
+        break;
+    case FORM_SURFACE:
+        surfaces.destroy(static_cast<Surface*>(slot.form));
+        break;
+    case FORM_FLUID:
+        fluids.destroy(static_cast<Fluid*>(slot.form));
+        break;
+    }
+    slot.form = NULL;
+    slot.generation++;
+    count--;
+}
+
+
+void FormArena::destroy(FormHandle handle)
+{
+    if (get(handle) == NULL)
+    {
+        return;
+    }
+    destroyForm(slots[handle.index]);
+    freeSlots.push_back(handle.index);
+}
+
+
+void FormArena::clear()
+{
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        if (slots[i].form != NULL)
+        {
+            destroyForm(slots[i]);
+        }
+    }
+    // All the slots free, the first ones taken first
+    freeSlots.clear();
+    for (int i = (int)slots.size() - 1; i >= 0; i--)
+    {
+        freeSlots.push_back(i);
+    }
+}
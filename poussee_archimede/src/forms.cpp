@@ -1,7 +1,7 @@
 #include <cmath>
-#include <SDL2/SDL_opengl.h>
-#include <GL/GLU.h>
 #include "forms.h"
+#include "physics.h"
+#include "mesh.h"
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
@@ -13,21 +13,31 @@ void Form::update(double delta_t)
 }
 
 
-void Form::render()
+Sphere::Sphere(double r, Color cl)
 {
-    // Point of view for rendering
-    // Common for all Forms
-    Point org = anim.getPos();
-    glColor3f(col.r, col.g, col.b);
-    glTranslated(org.x, org.y, org.z);
-    //glRotated(getAnim().getPhi(), 1, 0, 0);
+    radius = r;
+    col = cl;
+    lod = -1;
+    waves = NULL;
+    displaced = 0.0;
+    integrator = create_integrator(INTEGRATOR_EULER);
+    fluid = NULL;
+    fluidBody = 0;
+    // Solid sphere
+    double inertia = 0.4 * getMass() * r * r;
+    anim.setInertia(Vector(inertia, inertia, inertia));
+}
+
+Sphere::~Sphere()
+{
+    delete integrator;
 }
 
 
-Sphere::Sphere(double r, Color cl)
+void Sphere::setIntegrator(IntegratorType type)
 {
-    radius = r;
-    col = cl;
+    delete integrator;
+    integrator = create_integrator(type);
 }
 
 double Sphere::getVolume() {
@@ -35,7 +45,7 @@ double Sphere::getVolume() {
     return (4.0/3.0) * pi * pow(this->radius, 3);
 }
 double Sphere::getDensity() {
-    double density = 10000.0; // densit de la sphre, en kg/m^3
+    double density = SPHERE_DENSITY; // densit de la sphre, en kg/m^3
     return density;
 }
 
@@ -104,124 +114,95 @@ double Sphere::getMass() {
 //
 void Sphere::update(double delta_t) {
 
-    double dim = 1.0;
-    double waterLevel = 0.5 * dim;
+    double waterLevel = WATER_LEVEL;
     double sphereBottom = this->anim.getPos().y - this->radius;
 
-    // Calcul de la distance entre le centre de la sphre et la surface
-    double distance = this->anim.getPos().y - (waterLevel + this->radius);
-
-    // Vrifier si la sphre est au-dessus de la surface de l'eau
-    if (sphereBottom > waterLevel) {
-        Point ptM=this->anim.getPos(); //Position de l'objet
-        Vector OM(Point(0,0,0),ptM); //Vecteur entre la position de l'objet et sa
-        Vector vit; //Vecteur vitesse
-        Vector g(0,-9.81,0); //Sur l'axe y, -9.81 qui est le vecteur g soit la pesanteur
-
-        //Calcul du vecteur vitesse :
-        //delta_t = intervalle de temps donc sa position dans delta secondes
-        //g = Vecteur g : Acceleration due  la gravit
-        vit = this->anim.getSpeed() + delta_t*g;
-        //cout << this->anim.getSpeed() << "\n" ;
-
-        this->anim.setSpeed(vit); //Attribution de la vitesse
-
-        //Au vecteur OM, de positionnement on donne la vitesse pour la nouvelle position
-        OM = OM + delta_t*this->anim.getSpeed();
-        //cout << OM << "\n" ;
-        ptM=Point(OM.x,OM.y,OM.z);
-        this->anim.setPos(ptM); //Mise a jour de la position du centre de la sphere
-
-
-    } else if (distance <= 0) {
-
-        // La sphre touche ou est sous la surface de l'eau
-        double submergedPortion = std::min(std::max((waterLevel - sphereBottom) / (2 * this->radius), 0.0), 1.0);
-        double submergedVolume = this->getVolume() * submergedPortion;
-        double densityWater = 1000; // en kg/m^3
-        Vector buoyancyForce(0, -densityWater * submergedVolume * 9.81, 0); //Calcul de la flotabilit
-        Vector g(0,-9.81,0); //Sur l'axe y, -9.81 qui est le vecteur g soit la pesanteur
-
-        double dragCoefficient = 1.7; // Vous pouvez ajuster cette valeur pour obtenir le comportement souhait
-        Vector dragForce = -dragCoefficient * this->anim.getSpeed();
-
-        Vector totalForce = buoyancyForce + this->getMass() * g + dragForce;
-        double mass = this->getMass();
-        Vector acceleration(totalForce.x / mass, totalForce.y / mass, totalForce.z / mass);
-        //L'acclration d'un objet sur laquelle agit une force est directement proportionnelle
-        // la force agissant sur l'objet et  la masse de l'objet.
-
-
-        Vector vit = this->anim.getSpeed() - delta_t*acceleration; //attribution de la vitesse
-
-        this->anim.setSpeed(vit);
-
-
-
-        //Au vecteur OM, de positionnement on donne la vitesse pour la nouvelle position
-        Point ptM=this->anim.getPos();
-        Vector OM(Point(0,0,0),ptM);
-        OM = OM + delta_t*this->anim.getSpeed();
-        ptM=Point(OM.x,OM.y,OM.z);
-        this->anim.setPos(ptM); //Mise a jour de la position du centre de la sphere
-
-        // Si la sphre est compltement sous l'eau, arrter la chute en fixant la vitesse  zro
-        if (submergedPortion == 1.0) {
-
-            //vit = vit - 0.1 * vit ;
-            this->anim.setSpeed(Vector(0, 0, 0));
-
+    // Water level under the sphere, the water moved since the last step makes the waves
+    if (waves != NULL) {
+        Point center = this->anim.getPos();
+        waterLevel = waves->getLevel(center.x, center.z);
+        double submerged = this->getVolume() * submerged_portion(waterLevel - sphereBottom, this->radius);
+        if (submerged != displaced) {
+            waves->push(center.x, center.z, this->radius, submerged - displaced);
+            displaced = submerged;
         }
     }
 
-}
+    // Position et vitesse du centre avancées par le schéma d'intégration
+    SphereForces forces(this->radius, this->getVolume(), this->getMass(), waterLevel);
+    Point ptM = this->anim.getPos();
+    Vector vit = this->anim.getSpeed();
+    if (fluid != NULL) {
+        // Pushed by the particles during the fluid step just done
+        FluidForces fluidForces(fluid->getBody(fluidBody).force, this->getMass());
+        integrator->step(fluidForces, ptM, vit, delta_t);
+        this->anim.setAccel(fluidForces.acceleration(ptM, vit));
+    }
+    else {
+        integrator->step(forces, ptM, vit, delta_t);
+        this->anim.setAccel(forces.acceleration(ptM, vit));
+        this->anim.applyTorque(forces.torque(ptM), delta_t);
+    }
+    this->anim.setSpeed(vit);
+    this->anim.setPos(ptM); //Mise a jour de la position du centre de la sphere
 
+    // Turns at its angular speed
+    this->anim.rotate(delta_t);
+}
 
 
+SphereForces::SphereForces(double r, double vol, double mass, double level)
+{
+    radius = r;
+    volume = vol;
+    invMass = 1.0 / mass;
+    waterLevel = level;
+}
 
 
-void Sphere::rotate()
+Vector SphereForces::acceleration(const Point& pos, const Vector& spd) const
 {
-    //glTranslated(1,1,1);
-    glRotated(this->anim.getPhi(), 0, 1, 0) ; //Rotation sur y
-    glRotated(this->anim.getTheta(), 1, 0, 0) ; //Rotation sur x
+    // Same model as buoyancy_step
+    // Poussée d'Archimède : poids de l'eau déplacée (calotte sphérique immergée), vers le haut
+    double depth = waterLevel - (pos.y - radius);
+    double portion = submerged_portion(depth, radius);
+    double lift = WATER_DENSITY * GRAVITY * volume * portion * invMass;
+
+    // Frottement fluide dans l'eau, opposé à la vitesse
+    double speed = sqrt(spd * spd);
+    double drag = 0.5 * WATER_DENSITY * DRAG_COEFFICIENT * M_PI * radius * radius * portion * speed * invMass;
+    return Vector(-(drag * spd.x), (lift - GRAVITY) + -(drag * spd.y), -(drag * spd.z));
 }
 
-void Sphere::translation(int axe)
+
+Vector SphereForces::torque(const Point& pos) const
 {
-    //x
-    if (axe == 1){
-        glTranslated(this->anim.getSpeed().x,1,0);
-    }
+    double depth = waterLevel - (pos.y - radius);
+    double buoyancy = WATER_DENSITY * GRAVITY * volume * submerged_portion(depth, radius);
+    Vector arm(0, -buoyancy_center_depth(depth, radius), 0);
+    return arm ^ Vector(0, buoyancy, 0);
+}
 
-    //y
-    else if (axe == 2){
-        glTranslated(0.5,this->anim.getSpeed().x,0.5);
-    }
 
-    //z
-    else if (axe == 3){
-        glTranslated(0,0,this->anim.getSpeed().x);
-    }
+
+FluidForces::FluidForces(const Vector& force, double mass)
+{
+    fluid = 1.0 / mass * force;
 }
 
 
-void Sphere::render()
+Vector FluidForces::acceleration(const Point&, const Vector&) const
 {
-    GLUquadric *quad;
+    return fluid + Vector(0, -GRAVITY, 0);
+}
 
-    quad = gluNewQuadric();
 
-    // Complete this part
-    Form::render(); //Comme pour Cube_face render, on appelle Form:render
 
-    this->translation(2) ;
-    //this->rotate() ;
-    gluSphere(quad,radius,1000,1000);
-    //par3 et 4 = nombre de cots de la forme
 
-    gluDeleteQuadric(quad);
 
+Point Sphere::getRenderCenter() const
+{
+    return anim.getRenderPos();
 }
 
 
@@ -233,48 +214,33 @@ Cube_face::Cube_face(Vector v1, Vector v2, Point org, double l, double w, Color
     length = l;
     width = w;
     col = cl;
+    solid = true;
 }
 
 
-void Cube_face::update(double delta_t)
+void Cube_face::getCorners(Point corners[4]) const
 {
-    // Complete this part
-    this->anim.setPhi(this->anim.getPhi() + 1);
-
+    // Same corners as render(), from the face origin
+    corners[0] = anim.getRenderPos();
+    corners[1] = corners[0] + length * vdir1;
+    corners[2] = corners[1] + width * vdir2;
+    corners[3] = corners[0] + width * vdir2;
 }
 
 
-void Cube_face::render()
+Fluid::Fluid(SphFluid *f, Color cl)
 {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    Point p1 = Point();
-    Point p2 = p1, p3, p4 = p1;
-    p2.translate(length * vdir1);
-    p3 = p2;
-    p3.translate(width * vdir2);
-    p4.translate(width * vdir2);
-
-    Form::render();
-
-    // Render the Cube_face with transparency
-    glColor4f(col.r, col.g, col.b, col.t);
-    glBegin(GL_QUADS);
-    {
-        glVertex3d(p1.x, p1.y, p1.z);
-        glVertex3d(p2.x, p2.y, p2.z);
-        glVertex3d(p3.x, p3.y, p3.z);
-        glVertex3d(p4.x, p4.y, p4.z);
-    }
-    glEnd();
-
-    glDisable(GL_BLEND);
+    fluid = f;
+    col = cl;
 }
 
 
-Surface::Surface(GLfloat *points, int nbPointsX, int nbPointsZ)
+Surface::Surface(GLfloat *points, int nbPointsX, int nbPointsZ, Color cl, int order)
 {
+    col = cl;
+    waves = NULL;
+    tessellated = false;
+
     //Allocate 3d array of correct size
     GLfloat *ctrlPoints = new GLfloat[nbPointsX*nbPointsZ*3];
     // Store pointer in object
@@ -283,91 +249,90 @@ Surface::Surface(GLfloat *points, int nbPointsX, int nbPointsZ)
     // Copying array
     std::copy(points, points + nbPointsX * nbPointsZ * 3, ctrlPoints);
 
-    std::cout<<"Points : \n";
-    for (int i = 0; i < 108; i++) {
-        std::cout<<i<<" -> "<<points[i]<<"\n";
-    }
-
-    std::cout<<"ctrlPoints : \n";
-    for (int i = 0; i < 108; i++) {
-        std::cout<<i<<" -> "<<ctrlPoints[i]<<"\n";
-    }
-
     this->nbPointsX = nbPointsX;
     this->nbPointsZ = nbPointsZ;
 
-    this->nbNoeudsX = nbPointsX * 2;
-    this->nbNoeudsZ = nbPointsZ * 2;
+    int degreX = order > 0 ? std::min(order, nbPointsX) : nbPointsX;
+    int degreZ = order > 0 ? std::min(order, nbPointsZ) : nbPointsZ;
 
-    int degreX = nbPointsX;
-    int degreZ = nbPointsZ;
+    this->nbNoeudsX = nbPointsX + degreX;
+    this->nbNoeudsZ = nbPointsZ + degreZ;
 //
 //     influence parameter setting of each control point
 //     Les valeurs des noeuds doivent alterner au minimum tout les degrs fois
+//     Noeuds répétés degré fois aux extrémités, la surface passe par les coins du réseau
     GLfloat *noeudsX = new GLfloat[nbNoeudsX];
-    {
-        int k = 0;
-        int j = 0;
-        for(int h = 0; k < nbNoeudsX; h++) {
-            for(int i = 0; i < degreX; i++) {
-                j = 0;
-                noeudsX[k] = h;
-                k = k+1;
-            }
-            j=j+1;
-        }
+    for (int k = 0; k < nbNoeudsX; k++) {
+        noeudsX[k] = std::min(std::max(k - degreX + 1, 0), nbPointsX - degreX + 1);
     }
     this->NoeudsX = noeudsX;
 
     GLfloat *noeudsZ = new GLfloat[nbNoeudsZ];
-    {
-        int k = 0;
-        int j = 0;
-        for(int h = 0; k < nbNoeudsZ; h++) {
-            for(int i = 0; i < degreZ; i++) {
-                j = 0;
-                noeudsZ[k] = h;
-                k = k+1;
-            }
-            j=j+1;
-        }
+    for (int k = 0; k < nbNoeudsZ; k++) {
+        noeudsZ[k] = std::min(std::max(k - degreZ + 1, 0), nbPointsZ - degreZ + 1);
     }
     this->NoeudsZ = noeudsZ;
 
+    shape.set(ctrlPoints, nbPointsX, nbPointsZ, NoeudsX, nbNoeudsX, NoeudsZ, nbNoeudsZ);
+
 }
 
 
-void Surface::update(double delta_t)
+void Surface::setWaves(WaveField *w)
 {
+    delete waves;
+    waves = w;
 }
 
 
-void Surface::render()
+void Surface::update(double delta_t)
 {
+    if (waves == NULL)
+    {
+        return;
+    }
+
+    // Control points at the height of the water under them
+    Point org = anim.getPos();
+    for (int k = 0; k < nbPointsX * nbPointsZ; k++)
+    {
+        GLfloat *p = ctrlPoints + k * 3;
+        p[1] = waves->getLevel(p[0] + org.x, p[2] + org.z) - org.y;
+    }
+    shape.setPoints(ctrlPoints);
+    tessellated = false;
+}
+
 
-// Turn on the automatic method vector switch
-    glEnable(GL_AUTO_NORMAL);
-// Allow regularization vector
-    glEnable(GL_NORMALIZE);
-    GLUnurbsObj *theNurb;
-    theNurb = gluNewNurbsRenderer(); // Create a NURBS surface object
+Surface::~Surface()
+{
+    delete waves;
+    delete[] ctrlPoints;
+    delete[] NoeudsX;
+    delete[] NoeudsZ;
+}
 
-// Modify the properties of NURBS surface objects-glu library function
 
-// Sampling fault tolerance tolerance
+void Surface::setCtrlPoints(const GLfloat *points)
+{
+    std::copy(points, points + nbPointsX * nbPointsZ * 3, ctrlPoints);
+    shape.setPoints(ctrlPoints);
+    tessellated = false;
+}
 
-    gluNurbsProperty(theNurb, GLU_SAMPLING_TOLERANCE, 50);
-    gluNurbsProperty(theNurb, GLU_DISPLAY_MODE, GLU_OUTLINE_POLYGON);
 
-//    std::cout<<"Nb noeuds X : "<<nbNoeudsX<<"\n";
-//    std::cout<<"Nb noeuds Z : "<<nbNoeudsZ<<"\n";
-//    std::cout<<"Nb pts X : "<<nbPtsCtrlX<<"\n";
-//    std::cout<<"Nb pts Z : "<<nbPtsCtrlZ<<"\n";
+double Surface::getHeight(double x, double z)
+{
+    // Corners of the net
+    const GLfloat *first = ctrlPoints;
+    const GLfloat *lastX = ctrlPoints + (nbPointsX - 1) * 3;
+    const GLfloat *lastZ = ctrlPoints + (nbPointsZ - 1) * nbPointsX * 3;
 
-    //glColor3f( 1.0, 1.0, 1.0 );
-    gluBeginSurface(theNurb); // Start surface drawing
-    gluNurbsSurface(theNurb, nbNoeudsX, NoeudsX, nbNoeudsZ, NoeudsZ, nbPointsX * 3, 3, ctrlPoints, nbPointsX, nbPointsZ, GL_MAP2_VERTEX_3); // Define the surface Mathematical model to determine its shape
-    Form::render();
-    gluEndSurface(theNurb); // End surface drawing
+    Point org = anim.getPos();
+    double fx = (x - org.x - first[0]) / (lastX[0] - first[0]);
+    double fz = (z - org.z - first[2]) / (lastZ[2] - first[2]);
+    double u = shape.getMinU() + fx * (shape.getMaxU() - shape.getMinU());
+    double v = shape.getMinV() + fz * (shape.getMaxV() - shape.getMinV());
 
+    return org.y + shape.evaluate(u, v).y;
 }
@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <SDL2/SDL_opengl.h>
+#include "forms.h"
+#include "mesh.h"
+
+
+// Rendering of the forms, only built with the OpenGL targets
+
+
+void Form::render()
+{
+    // Point of view for rendering
+    // Common for all Forms
+    // Position interpolated between the two last physics steps
+    Point org = anim.getRenderPos();
+    glColor3f(col.r, col.g, col.b);
+    glTranslated(org.x, org.y, org.z);
+    //glRotated(getAnim().getPhi(), 1, 0, 0);
+}
+
+
+void Sphere::rotate()
+{
+    //glTranslated(1,1,1);
+    // Orientation interpolated between the two last physics steps
+    GLdouble matrix[16];
+    this->anim.getRenderOrientation().getMatrix(matrix);
+    glMultMatrixd(matrix);
+}
+
+
+void Sphere::translation(int axe)
+{
+    //x
+    if (axe == 1){
+        glTranslated(this->anim.getSpeed().x,1,0);
+    }
+
+    //y
+    else if (axe == 2){
+        glTranslated(0.5,this->anim.getSpeed().x,0.5);
+    }
+
+    //z
+    else if (axe == 3){
+        glTranslated(0,0,this->anim.getSpeed().x);
+    }
+}
+
+
+void Sphere::render()
+{
+    // Complete this part
+    Form::render(); //Comme pour Cube_face render, on appelle Form:render
+
+    this->rotate() ;
+
+    // Unit sphere built once and stored on the GPU, scaled to the radius
+    // GL_NORMALIZE keeps the scaled normals unit
+    glScaled(radius, radius, radius);
+    get_sphere_mesh(updateLod()).draw();
+}
+
+
+int Sphere::updateLod()
+{
+    // Tessellation according to the size on screen
+    lod = select_sphere_lod(projected_radius(getRenderCenter(), radius), lod);
+    return lod;
+}
+
+
+void Cube_face::render()
+{
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    Point p1 = Point();
+    Point p2 = p1, p3, p4 = p1;
+    p2.translate(length * vdir1);
+    p3 = p2;
+    p3.translate(width * vdir2);
+    p4.translate(width * vdir2);
+
+    Form::render();
+
+    // Render the Cube_face with transparency
+    glColor4f(col.r, col.g, col.b, col.t);
+    glBegin(GL_QUADS);
+    {
+        glVertex3d(p1.x, p1.y, p1.z);
+        glVertex3d(p2.x, p2.y, p2.z);
+        glVertex3d(p3.x, p3.y, p3.z);
+        glVertex3d(p4.x, p4.y, p4.z);
+    }
+    glEnd();
+
+    glDisable(GL_BLEND);
+}
+
+
+void Fluid::render()
+{
+    Form::render();
+
+    int n = fluid->size();
+    const double *x = fluid->getX(), *y = fluid->getY(), *z = fluid->getZ();
+    vertices.resize(n * 3);
+    for (int i = 0; i < n; i++)
+    {
+        vertices[i * 3 + 0] = (GLfloat)x[i];
+        vertices[i * 3 + 1] = (GLfloat)y[i];
+        vertices[i * 3 + 2] = (GLfloat)z[i];
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glColor4f(col.r, col.g, col.b, col.t);
+    glPointSize(2.0f);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, vertices.data());
+    glDrawArrays(GL_POINTS, 0, n);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisable(GL_BLEND);
+}
+
+
+void Surface::tessellate()
+{
+    // At least two samples between control points
+    shape.evaluateGrid(std::max(SURFACE_SAMPLES, 2 * nbPointsX - 1), std::max(SURFACE_SAMPLES, 2 * nbPointsZ - 1), grid);
+
+    mesh.clear();
+    for (int k = 0; k < grid.size(); k++)
+    {
+        mesh.addVertex(grid.x[k], grid.y[k], grid.z[k], grid.nx[k], grid.ny[k], grid.nz[k]);
+    }
+    for (int j = 0; j + 1 < grid.countV; j++)
+    {
+        for (int i = 0; i + 1 < grid.countU; i++)
+        {
+            GLuint a = grid.index(i, j), b = grid.index(i + 1, j);
+            GLuint c = grid.index(i + 1, j + 1), d = grid.index(i, j + 1);
+            mesh.addTriangle(a, d, c);
+            mesh.addTriangle(a, c, b);
+        }
+    }
+    mesh.upload();
+
+    tessellated = true;
+}
+
+
+void Surface::render()
+{
+    // Evaluation is costly : only done again when the control points change
+    if (!tessellated)
+    {
+        tessellate();
+    }
+
+    Form::render();
+    // Outline of the triangles, as the former GLU_OUTLINE_POLYGON display
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    mesh.draw();
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+}
+
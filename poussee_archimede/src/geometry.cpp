@@ -54,6 +54,90 @@ void Vector::operator+=(const Vector &v)
 }
 
 
+Quaternion::Quaternion(Vector axis, double angle)
+{
+    double n = axis.norm();
+    double s = n > 0 ? sin(0.5 * angle) / n : 0.0;
+
+    w = cos(0.5 * angle);
+    x = s * axis.x;
+    y = s * axis.y;
+    z = s * axis.z;
+}
+
+
+double Quaternion::norm() const
+{
+    return sqrt(w * w + x * x + y * y + z * z);
+}
+
+
+void Quaternion::normalize()
+{
+    double n = norm();
+
+    if (n > 0)
+    {
+        w /= n;
+        x /= n;
+        y /= n;
+        z /= n;
+    }
+    else
+    {
+        *this = Quaternion();
+    }
+}
+
+
+Vector Quaternion::rotate(const Vector &v) const
+{
+    // v + 2 w (u ^ v) + 2 u ^ (u ^ v), u the vector part : no trigonometry
+    Vector u(x, y, z);
+    Vector t = 2.0 * (u ^ v);
+
+    return v + w * t + (u ^ t);
+}
+
+
+Vector Quaternion::inverseRotate(const Vector &v) const
+{
+    return conjugate().rotate(v);
+}
+
+
+void Quaternion::getMatrix(double m[16]) const
+{
+    m[0] = 1 - 2 * (y * y + z * z);
+    m[1] = 2 * (x * y + w * z);
+    m[2] = 2 * (x * z - w * y);
+    m[3] = 0;
+    m[4] = 2 * (x * y - w * z);
+    m[5] = 1 - 2 * (x * x + z * z);
+    m[6] = 2 * (y * z + w * x);
+    m[7] = 0;
+    m[8] = 2 * (x * z + w * y);
+    m[9] = 2 * (y * z - w * x);
+    m[10] = 1 - 2 * (x * x + y * y);
+    m[11] = 0;
+    m[12] = m[13] = m[14] = 0;
+    m[15] = 1;
+}
+
+
+void Quaternion::integrate(const Vector &omega, double delta_t)
+{
+    // dq/dt = 1/2 (0, omega) q
+    Quaternion dq = Quaternion(0, omega.x, omega.y, omega.z) * (*this);
+
+    w += 0.5 * delta_t * dq.w;
+    x += 0.5 * delta_t * dq.x;
+    y += 0.5 * delta_t * dq.y;
+    z += 0.5 * delta_t * dq.z;
+    normalize();
+}
+
+
 double distance(Point p1, Point p2)
 {
     Vector vect(p1, p2);
@@ -132,3 +216,27 @@ Vector operator^(const Vector &v1, const Vector &v2)
 
     return res;
 }
+
+
+// Composition of rotations
+Quaternion operator*(const Quaternion &q1, const Quaternion &q2)
+{
+    return Quaternion(q1.w * q2.w - q1.x * q2.x - q1.y * q2.y - q1.z * q2.z,
+                      q1.w * q2.x + q1.x * q2.w + q1.y * q2.z - q1.z * q2.y,
+                      q1.w * q2.y - q1.x * q2.z + q1.y * q2.w + q1.z * q2.x,
+                      q1.w * q2.z + q1.x * q2.y - q1.y * q2.x + q1.z * q2.w);
+}
+
+Quaternion nlerp(const Quaternion &q1, const Quaternion &q2, double alpha)
+{
+    // q and -q are the same rotation : the closest one is taken
+    double dot = q1.w * q2.w + q1.x * q2.x + q1.y * q2.y + q1.z * q2.z;
+    double k = dot < 0 ? -alpha : alpha;
+    Quaternion res(q1.w + k * q2.w - alpha * q1.w,
+                   q1.x + k * q2.x - alpha * q1.x,
+                   q1.y + k * q2.y - alpha * q1.y,
+                   q1.z + k * q2.z - alpha * q1.z);
+
+    res.normalize();
+    return res;
+}
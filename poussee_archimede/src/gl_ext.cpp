@@ -0,0 +1,126 @@
+#include <cstring>
+#include <cstdio>
+#include "gl_ext.h"
+
+
+PFNGLGENBUFFERSPROC pglGenBuffers = NULL;
+PFNGLDELETEBUFFERSPROC pglDeleteBuffers = NULL;
+PFNGLBINDBUFFERPROC pglBindBuffer = NULL;
+PFNGLBUFFERDATAPROC pglBufferData = NULL;
+
+PFNGLCREATESHADERPROC pglCreateShader = NULL;
+PFNGLDELETESHADERPROC pglDeleteShader = NULL;
+PFNGLSHADERSOURCEPROC pglShaderSource = NULL;
+PFNGLCOMPILESHADERPROC pglCompileShader = NULL;
+PFNGLGETSHADERIVPROC pglGetShaderiv = NULL;
+PFNGLGETSHADERINFOLOGPROC pglGetShaderInfoLog = NULL;
+PFNGLCREATEPROGRAMPROC pglCreateProgram = NULL;
+PFNGLDELETEPROGRAMPROC pglDeleteProgram = NULL;
+PFNGLATTACHSHADERPROC pglAttachShader = NULL;
+PFNGLBINDATTRIBLOCATIONPROC pglBindAttribLocation = NULL;
+PFNGLLINKPROGRAMPROC pglLinkProgram = NULL;
+PFNGLGETPROGRAMIVPROC pglGetProgramiv = NULL;
+PFNGLGETPROGRAMINFOLOGPROC pglGetProgramInfoLog = NULL;
+PFNGLUSEPROGRAMPROC pglUseProgram = NULL;
+PFNGLENABLEVERTEXATTRIBARRAYPROC pglEnableVertexAttribArray = NULL;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray = NULL;
+PFNGLVERTEXATTRIBPOINTERPROC pglVertexAttribPointer = NULL;
+PFNGLVERTEXATTRIBDIVISORARBPROC pglVertexAttribDivisor = NULL;
+PFNGLDRAWELEMENTSINSTANCEDARBPROC pglDrawElementsInstanced = NULL;
+
+// Instancing is part of OpenGL 3.3, or available as an extension before
+static bool instancingSupported = false;
+
+
+bool load_gl_extensions(GLProcLoader loader)
+{
+    pglGenBuffers = (PFNGLGENBUFFERSPROC)loader("glGenBuffers");
+    pglDeleteBuffers = (PFNGLDELETEBUFFERSPROC)loader("glDeleteBuffers");
+    pglBindBuffer = (PFNGLBINDBUFFERPROC)loader("glBindBuffer");
+    pglBufferData = (PFNGLBUFFERDATAPROC)loader("glBufferData");
+
+    pglCreateShader = (PFNGLCREATESHADERPROC)loader("glCreateShader");
+    pglDeleteShader = (PFNGLDELETESHADERPROC)loader("glDeleteShader");
+    pglShaderSource = (PFNGLSHADERSOURCEPROC)loader("glShaderSource");
+    pglCompileShader = (PFNGLCOMPILESHADERPROC)loader("glCompileShader");
+    pglGetShaderiv = (PFNGLGETSHADERIVPROC)loader("glGetShaderiv");
+    pglGetShaderInfoLog = (PFNGLGETSHADERINFOLOGPROC)loader("glGetShaderInfoLog");
+    pglCreateProgram = (PFNGLCREATEPROGRAMPROC)loader("glCreateProgram");
+    pglDeleteProgram = (PFNGLDELETEPROGRAMPROC)loader("glDeleteProgram");
+    pglAttachShader = (PFNGLATTACHSHADERPROC)loader("glAttachShader");
+    pglBindAttribLocation = (PFNGLBINDATTRIBLOCATIONPROC)loader("glBindAttribLocation");
+    pglLinkProgram = (PFNGLLINKPROGRAMPROC)loader("glLinkProgram");
+    pglGetProgramiv = (PFNGLGETPROGRAMIVPROC)loader("glGetProgramiv");
+    pglGetProgramInfoLog = (PFNGLGETPROGRAMINFOLOGPROC)loader("glGetProgramInfoLog");
+    pglUseProgram = (PFNGLUSEPROGRAMPROC)loader("glUseProgram");
+    pglEnableVertexAttribArray = (PFNGLENABLEVERTEXATTRIBARRAYPROC)loader("glEnableVertexAttribArray");
+    pglDisableVertexAttribArray = (PFNGLDISABLEVERTEXATTRIBARRAYPROC)loader("glDisableVertexAttribArray");
+    pglVertexAttribPointer = (PFNGLVERTEXATTRIBPOINTERPROC)loader("glVertexAttribPointer");
+
+    // Core names first, extension names otherwise
+    const char* version = (const char*)glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (version != NULL)
+    {
+        sscanf(version, "%d.%d", &major, &minor);
+    }
+    if (major > 3 || (major == 3 && minor >= 3))
+    {
+        pglVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORARBPROC)loader("glVertexAttribDivisor");
+        pglDrawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDARBPROC)loader("glDrawElementsInstanced");
+    }
+    else if (has_gl_extension("GL_ARB_instanced_arrays") && has_gl_extension("GL_ARB_draw_instanced"))
+    {
+        pglVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORARBPROC)loader("glVertexAttribDivisorARB");
+        pglDrawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDARBPROC)loader("glDrawElementsInstancedARB");
+    }
+    instancingSupported = has_vertex_buffers()
+                          && pglCreateShader != NULL && pglDeleteShader != NULL && pglShaderSource != NULL
+                          && pglCompileShader != NULL && pglGetShaderiv != NULL && pglGetShaderInfoLog != NULL
+                          && pglCreateProgram != NULL && pglDeleteProgram != NULL && pglAttachShader != NULL
+                          && pglBindAttribLocation != NULL && pglLinkProgram != NULL && pglGetProgramiv != NULL
+                          && pglGetProgramInfoLog != NULL && pglUseProgram != NULL
+                          && pglEnableVertexAttribArray != NULL && pglDisableVertexAttribArray != NULL
+                          && pglVertexAttribPointer != NULL
+                          && pglVertexAttribDivisor != NULL && pglDrawElementsInstanced != NULL;
+
+    return has_vertex_buffers();
+}
+
+
+bool has_vertex_buffers()
+{
+    return pglGenBuffers != NULL && pglDeleteBuffers != NULL
+           && pglBindBuffer != NULL && pglBufferData != NULL;
+}
+
+
+bool has_instancing()
+{
+    return instancingSupported;
+}
+
+
+bool has_gl_extension(const char* name)
+{
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    if (extensions == NULL)
+    {
+        return false;
+    }
+
+    // Whole words only : a name can be the prefix of another one
+    size_t length = strlen(name);
+    const char* found = strstr(extensions, name);
+    while (found != NULL)
+    {
+        bool start = (found == extensions || found[-1] == ' ');
+        bool end = (found[length] == ' ' || found[length] == '\0');
+        if (start && end)
+        {
+            return true;
+        }
+        found = strstr(found + length, name);
+    }
+    return false;
+}
@@ -0,0 +1,422 @@
+// Headless runner : advances the simulation as fast as the CPU allows
+// No SDL video initialization nor OpenGL context, the forms are only updated
+// Usage : headless [duration (s)] [time step (s)] [number of bodies] [scalar|sse2|avx2] [number of threads] [waves grid size] [hull triangles] [euler|verlet|rk4|rk45] [grid|sweep] [fluid particles]
+// With a number of bodies, a batch of spheres colliding in the tank is simulated instead of the scene
+// With a waves grid size, only the waves of a square grid are simulated
+// With a number of hull triangles, a single hull dropped tilted floats and rights itself
+// With a number of fluid particles, a dam breaks in the tank on a floating sphere
+// The kernel instruction set is detected unless given
+// The spheres of the scene are integrated with semi-implicit Euler unless given
+// The collisions are found with the uniform grid unless given
+// All the hardware threads are used unless given, results don't depend on it
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+
+// Module for space geometry
+#include "geometry.h"
+// Module for generating and rendering forms
+#include "forms.h"
+// Module for creating and updating the simulation
+#include "scene.h"
+// Module for batched spheres
+#include "bodies.h"
+// Module for the collisions
+#include "collision.h"
+// Module for parallel loops
+#include "thread_pool.h"
+// Module for the waves
+#include "waves.h"
+// Module for the physical constants
+#include "physics.h"
+// Module for the hulls buoyancy
+#include "hull.h"
+// Module for the meshes
+#include "mesh.h"
+// Module for the fluid particles
+#include "sph.h"
+// Module for the spatial sorts
+#include "spatial_sort.h"
+
+
+/***************************************************************************/
+/* Constants                                                               */
+/***************************************************************************/
+// Default simulated duration (in s)
+const double DEFAULT_DURATION = 10.0;
+
+// Default physics time step (in s)
+const double DEFAULT_TIME_STEP = 1e-3;
+
+// Density of the floating hull (in kg/m^3), floats half submerged
+const double HULL_DENSITY = 0.5 * WATER_DENSITY;
+
+// Height of the hull over its width : flat enough to right itself
+const double HULL_FLATNESS = 0.4;
+
+// Initial heel of the hull (in degrees)
+const double HULL_TILT = 30.0;
+
+
+// Simulates the forms of the interactive program
+void run_scene(double duration, double delta_t, IntegratorType integrator, BroadPhaseType broad_phase, ThreadPool& pool);
+
+// Simulates a batch of spheres stored as arrays
+void run_bodies(double duration, double delta_t, int number_of_bodies, BroadPhaseType broad_phase, ThreadPool& pool);
+
+// Simulates the waves of a square grid of cells, started by a drop in the middle
+void run_waves(double duration, double delta_t, int grid_size, ThreadPool& pool);
+
+// Simulates the heave of a sphere shaped hull of about the given number of triangles
+void run_hull(double duration, double delta_t, int number_of_triangles, ThreadPool& pool);
+
+// Simulates a water column of about the given number of particles collapsing in the tank, a sphere floating in it
+void run_fluid(double duration, double delta_t, int number_of_particles, ThreadPool& pool);
+
+// Prints the wall clock time and throughput of a run
+void print_timing(long number_of_steps, double delta_t, double wall_time, int number_of_bodies);
+
+
+/***************************************************************************/
+/* Functions implementations                                               */
+/***************************************************************************/
+void run_scene(double duration, double delta_t, IntegratorType integrator, BroadPhaseType broad_phase, ThreadPool& pool)
+{
+    // The forms to simulate, same scene as the interactive program
+    Scene scene;
+    int number_of_forms = create_scene(scene, integrator, broad_phase);
+
+    // Fixed step simulation, not tied to any display
+    long number_of_steps = (long)(duration / delta_t + 0.5);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long n = 0; n < number_of_steps; n++)
+    {
+        update(scene, delta_t, pool);
+    }
+    std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - start;
+
+    // Final state of the forms
+    for (int i = 0; i < number_of_forms; i++)
+    {
+        Animation& anim = scene.getForm(i)->getAnim();
+        std::cout << "Form " << i << " : position " << anim.getPos()
+                  << " speed " << anim.getSpeed() << std::endl;
+    }
+
+    // Cost of the integration scheme
+    long evaluations = 0;
+    for (size_t i = 0; i < scene.getSpheres().size(); i++)
+    {
+        evaluations += scene.getSpheres()[i]->getIntegrator().getEvaluations();
+    }
+    std::cout << integrator_name(integrator) << " integrator : " << evaluations << " force evaluations" << std::endl;
+
+    print_timing(number_of_steps, delta_t, wall_time.count(), number_of_forms);
+}
+
+
+void run_bodies(double duration, double delta_t, int number_of_bodies, BroadPhaseType broad_phase, ThreadPool& pool)
+{
+    BodyStore bodies;
+    create_bodies(bodies, number_of_bodies);
+    // Same tank walls as the scene
+    Scene scene;
+    create_scene(scene);
+    CollisionSystem collisions(broad_phase);
+    add_walls(collisions, scene);
+    scene.clear();
+
+    // Bodies close in the tank kept close in memory, cells of the largest body size
+    SpatialSort body_sort(ORDER_MORTON, MORTON_INTERVAL);
+    double max_radius = 0;
+    for (int i = 0; i < bodies.size(); i++)
+    {
+        max_radius = std::max(max_radius, bodies.getRadius(i));
+    }
+    body_sort.setGrid(Point(-0.5, -0.5, -0.5), Point(0.5, 0.7, 0.5), 2.0 * max_radius);
+
+    long number_of_steps = (long)(duration / delta_t + 0.5);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long n = 0; n < number_of_steps; n++)
+    {
+        if (body_sort.isDue())
+        {
+            BodyArrays arrays = bodies.getArrays();
+            body_sort.sort(arrays.px, arrays.py, arrays.pz, arrays.count);
+            bodies.reorder(body_sort);
+            collisions.renumberBodies(body_sort.getRank());
+        }
+        bodies.step(delta_t, pool);
+        BodyArrays arrays = bodies.getArrays();
+        collisions.step(arrays, pool);
+    }
+    std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - start;
+
+    // Summary of the final state
+    double min_y = 0, max_y = 0, mean_y = 0;
+    for (int i = 0; i < bodies.size(); i++)
+    {
+        double y = bodies.getPos(i).y;
+        if (i == 0 || y < min_y) min_y = y;
+        if (i == 0 || y > max_y) max_y = y;
+        mean_y += y / bodies.size();
+    }
+    std::cout << bodies.size() << " bodies (" << kernel_level_name(get_kernel_level())
+              << " kernel, " << pool.size() << " threads) : height min " << min_y
+              << " max " << max_y << " mean " << mean_y << std::endl;
+    std::cout << broad_phase_name(broad_phase) << " broad phase : " << collisions.getPairCount() << " pairs, "
+              << collisions.getContacts().size() << " contacts" << std::endl;
+
+    print_timing(number_of_steps, delta_t, wall_time.count(), bodies.size());
+}
+
+
+void run_waves(double duration, double delta_t, int grid_size, ThreadPool& pool)
+{
+    // 1 m cells, 1 m deep
+    WaveField waves(grid_size, grid_size, 0, 0, 1.0, 0, 1.0);
+    waves.push(grid_size / 2.0, grid_size / 2.0, 4.0, 10.0);
+
+    long number_of_steps = (long)(duration / delta_t + 0.5);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long n = 0; n < number_of_steps; n++)
+    {
+        waves.step(delta_t, pool);
+    }
+    std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - start;
+
+    std::cout << grid_size << " x " << grid_size << " waves (" << kernel_level_name(get_kernel_level())
+              << " kernel, " << pool.size() << " threads) : level in the middle " << waves.getLevel(grid_size / 2.0, grid_size / 2.0)
+              << " volume " << waves.getVolume() << std::endl;
+
+    // Cells are the bodies of this run
+    print_timing(number_of_steps, delta_t, wall_time.count(), grid_size * grid_size);
+}
+
+
+void run_hull(double duration, double delta_t, int number_of_triangles, ThreadPool& pool)
+{
+    // Unit sphere flattened into a disc shaped hull, about slices^2 triangles
+    Mesh sphere;
+    int slices = std::max((int)sqrt((double)number_of_triangles), 4);
+    sphere.buildSphere(slices, slices / 2);
+    std::vector<float> vertices = sphere.getVertices();
+    for (size_t i = 1; i < vertices.size(); i += 3)
+    {
+        vertices[i] *= HULL_FLATNESS;
+    }
+    Hull hull;
+    hull.addTriangles(vertices.data(), sphere.getIndices().data(), sphere.getTriangleCount());
+    double mass = HULL_DENSITY * hull.getVolume();
+
+    // Dropped tilted from above the water, turns under the torque of the buoyancy around its center of mass
+    // Solid ellipsoid of semi axes 1, HULL_FLATNESS, 1 : I = m / 5 (b^2 + c^2)
+    Animation anim;
+    anim.setPos(Point(0, WATER_LEVEL + 2.0, 0));
+    anim.setOrientation(Quaternion(Vector(1, 0, 0), HULL_TILT * M_PI / 180.0));
+    anim.setInertia(Vector(0.2 * mass * (1.0 + HULL_FLATNESS * HULL_FLATNESS),
+                           0.4 * mass,
+                           0.2 * mass * (1.0 + HULL_FLATNESS * HULL_FLATNESS)));
+    HullForces forces;
+    long number_of_steps = (long)(duration / delta_t + 0.5);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long n = 0; n < number_of_steps; n++)
+    {
+        Point pos = anim.getPos();
+        Vector speed = anim.getSpeed();
+        forces = hull.hydrostatic(pos, anim.getOrientation(), WATER_LEVEL, pos, pool);
+
+        // Semi-implicit Euler, the water damps the heave and the roll
+        double damping = forces.volume > 0 ? WAVE_DAMPING : 0.0;
+        speed = speed + delta_t * ((1.0 / mass) * forces.force - Vector(0, GRAVITY, 0) - damping * speed);
+        anim.setSpeed(speed);
+        anim.setPos(pos + delta_t * speed);
+        anim.applyTorque(forces.torque, delta_t);
+        anim.setAngularSpeed((1.0 - damping * delta_t) * anim.getAngularSpeed());
+        anim.rotate(delta_t);
+    }
+    std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - start;
+
+    // Angle between the hull axis and the vertical, 0 once righted
+    double tilt = acos(std::min(anim.toWorld(Vector(0, 1, 0)).y, 1.0)) * 180.0 / M_PI;
+    std::cout << hull.size() << " triangles hull (" << kernel_level_name(get_kernel_level())
+              << " kernel, " << pool.size() << " threads) : height " << anim.getPos().y
+              << " submerged volume " << forces.volume << " at rest " << mass / WATER_DENSITY
+              << " tilt " << tilt << " deg from " << HULL_TILT << std::endl;
+
+    // Triangles are the bodies of this run
+    print_timing(number_of_steps, delta_t, wall_time.count(), hull.size());
+}
+
+
+void run_fluid(double duration, double delta_t, int number_of_particles, ThreadPool& pool)
+{
+    // Left half of the tank filled up to the water level, the particles spaced to fill it
+    double volume = 0.5 * (WATER_LEVEL + 0.5);
+    double spacing = cbrt(volume / number_of_particles);
+    SphFluid *fluid = new SphFluid(Point(-0.5, -0.5, -0.5), Point(0.5, 0.7, 0.5), spacing);
+    fluid->fill(Point(-0.5, -0.5, -0.5), Point(0, WATER_LEVEL, 0.5));
+
+    // Same update as the scene, in the tank walls of the scene : the fluid first, then the sphere
+    Scene scene;
+    create_scene(scene);
+    scene.clear();
+    scene.add<Fluid>(fluid);
+
+    // Sphere at rest in the right half, the wave comes over it
+    Sphere *sphere = scene.add<Sphere>(0.15, ORANGE);
+    sphere->getAnim().setPos(Point(0.25, -0.3, 0));
+    sphere->setFluid(fluid, fluid->addBody(sphere->getAnim().getPos(), sphere->getAnim().getSpeed(), sphere->getRadius()));
+
+    long number_of_steps = (long)(duration / delta_t + 0.5);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long n = 0; n < number_of_steps; n++)
+    {
+        update(scene, delta_t, pool);
+    }
+    std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - start;
+
+    // Front of the water and highest splash
+    double front = -0.5, top = -0.5;
+    for (int i = 0; i < fluid->size(); i++)
+    {
+        front = std::max(front, fluid->getX()[i]);
+        top = std::max(top, fluid->getY()[i]);
+    }
+    std::cout << fluid->size() << " particles of " << spacing << " m (" << pool.size() << " threads, "
+              << (double)fluid->getSubsteps() / std::max(number_of_steps, 1L) << " sub steps per step) : front "
+              << front << " top " << top << std::endl;
+    std::cout << "Sphere : position " << sphere->getAnim().getPos() << " speed " << sphere->getAnim().getSpeed() << std::endl;
+
+    // Particles are the bodies of this run
+    print_timing(number_of_steps, delta_t, wall_time.count(), fluid->size());
+}
+
+
+void print_timing(long number_of_steps, double delta_t, double wall_time, int number_of_bodies)
+{
+    std::cout << number_of_steps << " steps of " << delta_t << " s in "
+              << wall_time << " s";
+    if (wall_time > 0)
+    {
+        std::cout << " (" << number_of_steps / wall_time << " steps/s, "
+                  << number_of_steps * (double)number_of_bodies / wall_time << " body steps/s)";
+    }
+    std::cout << std::endl;
+}
+
+
+/***************************************************************************/
+/* MAIN Function                                                           */
+/***************************************************************************/
+int main(int argc, char* args[])
+{
+    double duration = DEFAULT_DURATION;
+    double delta_t = DEFAULT_TIME_STEP;
+    int number_of_bodies = 0;
+    int number_of_threads = 0;
+    int grid_size = 0;
+    int number_of_triangles = 0;
+    int number_of_particles = 0;
+    IntegratorType integrator = INTEGRATOR_EULER;
+    BroadPhaseType broad_phase = BROADPHASE_GRID;
+
+    if (argc > 1)
+    {
+        duration = std::atof(args[1]);
+    }
+    if (argc > 2)
+    {
+        delta_t = std::atof(args[2]);
+    }
+    if (argc > 3)
+    {
+        number_of_bodies = std::atoi(args[3]);
+    }
+    if (argc > 4)
+    {
+        if (strcmp(args[4], "scalar") == 0)
+        {
+            set_kernel_level(KERNEL_SCALAR);
+        }
+        else if (strcmp(args[4], "sse2") == 0)
+        {
+            set_kernel_level(KERNEL_SSE2);
+        }
+        else
+        {
+            set_kernel_level(KERNEL_AVX2);
+        }
+    }
+    if (argc > 5)
+    {
+        number_of_threads = std::atoi(args[5]);
+    }
+    if (argc > 6)
+    {
+        grid_size = std::atoi(args[6]);
+    }
+    if (argc > 7)
+    {
+        number_of_triangles = std::atoi(args[7]);
+    }
+    if (argc > 8)
+    {
+        if (strcmp(args[8], "verlet") == 0)
+        {
+            integrator = INTEGRATOR_VERLET;
+        }
+        else if (strcmp(args[8], "rk4") == 0)
+        {
+            integrator = INTEGRATOR_RK4;
+        }
+        else if (strcmp(args[8], "rk45") == 0)
+        {
+            integrator = INTEGRATOR_RK45;
+        }
+    }
+    if (argc > 9)
+    {
+        if (strcmp(args[9], "sweep") == 0)
+        {
+            broad_phase = BROADPHASE_SWEEP;
+        }
+    }
+    if (argc > 10)
+    {
+        number_of_particles = std::atoi(args[10]);
+    }
+    if (duration <= 0 || delta_t <= 0 || number_of_bodies < 0 || number_of_threads < 0 || grid_size < 0 || number_of_triangles < 0
+        || number_of_particles < 0)
+    {
+        std::cout << "Usage : " << args[0] << " [duration (s)] [time step (s)] [number of bodies] [scalar|sse2|avx2] [number of threads] [waves grid size] [hull triangles] [euler|verlet|rk4|rk45] [grid|sweep] [fluid particles]" << std::endl;
+        return 1;
+    }
+
+    ThreadPool pool(number_of_threads);
+    if (number_of_particles > 0)
+    {
+        run_fluid(duration, delta_t, number_of_particles, pool);
+    }
+    else if (number_of_triangles > 0)
+    {
+        run_hull(duration, delta_t, number_of_triangles, pool);
+    }
+    else if (grid_size > 0)
+    {
+        run_waves(duration, delta_t, grid_size, pool);
+    }
+    else if (number_of_bodies > 0)
+    {
+        run_bodies(duration, delta_t, number_of_bodies, broad_phase, pool);
+    }
+    else
+    {
+        run_scene(duration, delta_t, integrator, broad_phase, pool);
+    }
+
+    return 0;
+}
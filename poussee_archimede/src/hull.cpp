@@ -0,0 +1,462 @@
+#include <algorithm>
+#include "hull.h"
+#include "physics.h"
+#include "kernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_X86
+#include <immintrin.h>
+#endif
+
+
+// For each submerged triangle, with r the vertices relative to the torque center, d their depths
+// and N = (r1 - r0) ^ (r2 - r0) twice its area along the normal :
+//  force = -rho g / 6 * (d0 + d1 + d2) N
+//  torque = -rho g / 24 * (d0 r0 + d1 r1 + d2 r2 + (d0 + d1 + d2)(r0 + r1 + r2)) ^ N
+// (integrals of a linear function over a triangle), the kernels only sum the vectors
+
+
+// Triangles of the hull, seen from the torque center, in the body coordinates
+class HullView
+{
+public:
+    const double *ax, *ay, *az, *bx, *by, *bz, *cx, *cy, *cz;
+    double offx, offy, offz; // origin - center
+    double upx, upy, upz; // Vertical
+    double level; // Water level along the vertical : depth = level - up * vertex
+};
+
+
+// Sums of a chunk, before the constant factors
+class HullSums
+{
+public:
+    double f[3], t[3];
+    HullSums() {f[0] = f[1] = f[2] = 0.0; t[0] = t[1] = t[2] = 0.0;}
+};
+
+
+void HullForces::operator+=(const HullForces& f)
+{
+    force += f.force;
+    torque += f.torque;
+    volume += f.volume;
+}
+
+
+void Hull::reserve(int n)
+{
+    ax.reserve(n); ay.reserve(n); az.reserve(n);
+    bx.reserve(n); by.reserve(n); bz.reserve(n);
+    cx.reserve(n); cy.reserve(n); cz.reserve(n);
+}
+
+
+void Hull::clear()
+{
+    ax.clear(); ay.clear(); az.clear();
+    bx.clear(); by.clear(); bz.clear();
+    cx.clear(); cy.clear(); cz.clear();
+}
+
+
+void Hull::addTriangle(Point a, Point b, Point c)
+{
+    ax.push_back(a.x); ay.push_back(a.y); az.push_back(a.z);
+    bx.push_back(b.x); by.push_back(b.y); bz.push_back(b.z);
+    cx.push_back(c.x); cy.push_back(c.y); cz.push_back(c.z);
+}
+
+
+void Hull::addQuad(Point org, Vector v1, Vector v2, double l, double w)
+{
+    Point p1 = org + l * v1;
+    Point p2 = p1 + w * v2;
+    Point p3 = org + w * v2;
+    addTriangle(org, p1, p2);
+    addTriangle(org, p2, p3);
+}
+
+
+void Hull::addBox(double sx, double sy, double sz)
+{
+    Point low(-0.5 * sx, -0.5 * sy, -0.5 * sz);
+    Vector x(1, 0, 0), y(0, 1, 0), z(0, 0, 1);
+    addQuad(low, z, y, sz, sy);
+    addQuad(Point(0.5 * sx, low.y, low.z), y, z, sy, sz);
+    addQuad(low, x, z, sx, sz);
+    addQuad(Point(low.x, 0.5 * sy, low.z), z, x, sz, sx);
+    addQuad(low, y, x, sy, sx);
+    addQuad(Point(low.x, low.y, 0.5 * sz), x, y, sx, sy);
+}
+
+
+void Hull::addTriangles(const float *vertices, const unsigned int *indices, int number_of_triangles)
+{
+    reserve(size() + number_of_triangles);
+    for (int k = 0; k < number_of_triangles; k++)
+    {
+        const float *a = vertices + 3 * indices[3 * k];
+        const float *b = vertices + 3 * indices[3 * k + 1];
+        const float *c = vertices + 3 * indices[3 * k + 2];
+        addTriangle(Point(a[0], a[1], a[2]), Point(b[0], b[1], b[2]), Point(c[0], c[1], c[2]));
+    }
+}
+
+
+double Hull::getVolume() const
+{
+    // Divergence theorem : sum of the tetrahedra from the origin
+    double volume = 0.0;
+    for (int k = 0; k < size(); k++)
+    {
+        volume += ax[k] * (by[k] * cz[k] - bz[k] * cy[k])
+                + ay[k] * (bz[k] * cx[k] - bx[k] * cz[k])
+                + az[k] * (bx[k] * cy[k] - by[k] * cx[k]);
+    }
+    return volume / 6.0;
+}
+
+
+// Adds a submerged triangle
+static void add_triangle(const double r[][3], const double d[], HullSums& sums)
+{
+    double e1[3] = {r[1][0] - r[0][0], r[1][1] - r[0][1], r[1][2] - r[0][2]};
+    double e2[3] = {r[2][0] - r[0][0], r[2][1] - r[0][1], r[2][2] - r[0][2]};
+    double n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+
+    double sd = d[0] + d[1] + d[2];
+    double s[3];
+    for (int c = 0; c < 3; c++)
+    {
+        s[c] = d[0] * r[0][c] + d[1] * r[1][c] + d[2] * r[2][c] + sd * (r[0][c] + r[1][c] + r[2][c]);
+        sums.f[c] += sd * n[c];
+    }
+    sums.t[0] += s[1] * n[2] - s[2] * n[1];
+    sums.t[1] += s[2] * n[0] - s[0] * n[2];
+    sums.t[2] += s[0] * n[1] - s[1] * n[0];
+}
+
+
+// Adds the submerged part of a triangle crossing the water plane
+// Sutherland-Hodgman clipping keeps the vertices order : 3 or 4 vertices, split in a fan
+static void add_clipped(const double r[][3], const double d[], HullSums& sums)
+{
+    double p[4][3], pd[4];
+    int count = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        int j = (i + 1) % 3;
+        if (d[i] >= 0.0)
+        {
+            std::copy(r[i], r[i] + 3, p[count]);
+            pd[count] = d[i];
+            count++;
+        }
+        if ((d[i] >= 0.0) != (d[j] >= 0.0))
+        {
+            double s = d[i] / (d[i] - d[j]);
+            for (int c = 0; c < 3; c++)
+            {
+                p[count][c] = r[i][c] + s * (r[j][c] - r[i][c]);
+            }
+            pd[count] = 0.0;
+            count++;
+        }
+    }
+
+    for (int k = 1; k + 1 < count; k++)
+    {
+        double tr[3][3], td[3] = {pd[0], pd[k], pd[k + 1]};
+        std::copy(p[0], p[0] + 3, tr[0]);
+        std::copy(p[k], p[k] + 3, tr[1]);
+        std::copy(p[k + 1], p[k + 1] + 3, tr[2]);
+        add_triangle(tr, td, sums);
+    }
+}
+
+
+// Triangle k of the hull, relative to the torque center
+static void load_triangle(const HullView& h, int k, double r[][3], double d[])
+{
+    r[0][0] = h.ax[k] + h.offx; r[0][1] = h.ay[k] + h.offy; r[0][2] = h.az[k] + h.offz;
+    r[1][0] = h.bx[k] + h.offx; r[1][1] = h.by[k] + h.offy; r[1][2] = h.bz[k] + h.offz;
+    r[2][0] = h.cx[k] + h.offx; r[2][1] = h.cy[k] + h.offy; r[2][2] = h.cz[k] + h.offz;
+    d[0] = h.level - (h.upx * h.ax[k] + h.upy * h.ay[k] + h.upz * h.az[k]);
+    d[1] = h.level - (h.upx * h.bx[k] + h.upy * h.by[k] + h.upz * h.bz[k]);
+    d[2] = h.level - (h.upx * h.cx[k] + h.upy * h.cy[k] + h.upz * h.cz[k]);
+}
+
+
+static void sums_scalar(const HullView& h, int begin, int end, HullSums& sums)
+{
+    double r[3][3], d[3];
+    for (int k = begin; k < end; k++)
+    {
+        load_triangle(h, k, r, d);
+        bool full = d[0] >= 0.0 && d[1] >= 0.0 && d[2] >= 0.0;
+        bool any = d[0] >= 0.0 || d[1] >= 0.0 || d[2] >= 0.0;
+        if (full)
+        {
+            add_triangle(r, d, sums);
+        }
+        else if (any)
+        {
+            add_clipped(r, d, sums);
+        }
+    }
+}
+
+
+// Triangles crossing the water plane : the few ones along the water line, clipped one by one
+static void sums_crossing(const HullView& h, const std::vector<int>& crossing, HullSums& sums)
+{
+    double r[3][3], d[3];
+    for (size_t n = 0; n < crossing.size(); n++)
+    {
+        load_triangle(h, crossing[n], r, d);
+        add_clipped(r, d, sums);
+    }
+}
+
+
+#ifdef KERNEL_X86
+
+// The vector loops sum the fully submerged triangles with masks
+// and list the crossing ones, clipped afterwards
+
+__attribute__((target("sse2")))
+static void sums_sse2(const HullView& h, int begin, int end, HullSums& sums)
+{
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d level = _mm_set1_pd(h.level);
+    const __m128d offx = _mm_set1_pd(h.offx), offy = _mm_set1_pd(h.offy), offz = _mm_set1_pd(h.offz);
+    const __m128d upx = _mm_set1_pd(h.upx), upy = _mm_set1_pd(h.upy), upz = _mm_set1_pd(h.upz);
+    __m128d fx = zero, fy = zero, fz = zero, tx = zero, ty = zero, tz = zero;
+    std::vector<int> crossing;
+
+    int k = begin;
+    for (; k + 2 <= end; k += 2)
+    {
+        __m128d v0x = _mm_loadu_pd(h.ax + k), v0y = _mm_loadu_pd(h.ay + k), v0z = _mm_loadu_pd(h.az + k);
+        __m128d v1x = _mm_loadu_pd(h.bx + k), v1y = _mm_loadu_pd(h.by + k), v1z = _mm_loadu_pd(h.bz + k);
+        __m128d v2x = _mm_loadu_pd(h.cx + k), v2y = _mm_loadu_pd(h.cy + k), v2z = _mm_loadu_pd(h.cz + k);
+        __m128d d0 = _mm_sub_pd(level, _mm_add_pd(_mm_add_pd(_mm_mul_pd(upx, v0x), _mm_mul_pd(upy, v0y)), _mm_mul_pd(upz, v0z)));
+        __m128d d1 = _mm_sub_pd(level, _mm_add_pd(_mm_add_pd(_mm_mul_pd(upx, v1x), _mm_mul_pd(upy, v1y)), _mm_mul_pd(upz, v1z)));
+        __m128d d2 = _mm_sub_pd(level, _mm_add_pd(_mm_add_pd(_mm_mul_pd(upx, v2x), _mm_mul_pd(upy, v2y)), _mm_mul_pd(upz, v2z)));
+
+        __m128d in0 = _mm_cmpge_pd(d0, zero), in1 = _mm_cmpge_pd(d1, zero), in2 = _mm_cmpge_pd(d2, zero);
+        __m128d full = _mm_and_pd(_mm_and_pd(in0, in1), in2);
+        __m128d any = _mm_or_pd(_mm_or_pd(in0, in1), in2);
+        int fullMask = _mm_movemask_pd(full);
+        int crossMask = _mm_movemask_pd(_mm_andnot_pd(full, any));
+        for (int lane = 0; lane < 2; lane++)
+        {
+            if (crossMask & (1 << lane))
+            {
+                crossing.push_back(k + lane);
+            }
+        }
+        if (fullMask == 0)
+        {
+            continue;
+        }
+
+        __m128d r0x = _mm_add_pd(v0x, offx), r0y = _mm_add_pd(v0y, offy), r0z = _mm_add_pd(v0z, offz);
+        __m128d r1x = _mm_add_pd(v1x, offx), r1y = _mm_add_pd(v1y, offy), r1z = _mm_add_pd(v1z, offz);
+        __m128d r2x = _mm_add_pd(v2x, offx), r2y = _mm_add_pd(v2y, offy), r2z = _mm_add_pd(v2z, offz);
+        __m128d e1x = _mm_sub_pd(r1x, r0x), e1y = _mm_sub_pd(r1y, r0y), e1z = _mm_sub_pd(r1z, r0z);
+        __m128d e2x = _mm_sub_pd(r2x, r0x), e2y = _mm_sub_pd(r2y, r0y), e2z = _mm_sub_pd(r2z, r0z);
+        __m128d nx = _mm_sub_pd(_mm_mul_pd(e1y, e2z), _mm_mul_pd(e1z, e2y));
+        __m128d ny = _mm_sub_pd(_mm_mul_pd(e1z, e2x), _mm_mul_pd(e1x, e2z));
+        __m128d nz = _mm_sub_pd(_mm_mul_pd(e1x, e2y), _mm_mul_pd(e1y, e2x));
+
+        // Non submerged lanes weigh 0
+        __m128d sd = _mm_and_pd(full, _mm_add_pd(_mm_add_pd(d0, d1), d2));
+        d0 = _mm_and_pd(full, d0);
+        d1 = _mm_and_pd(full, d1);
+        d2 = _mm_and_pd(full, d2);
+        __m128d sx = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(d0, r0x), _mm_mul_pd(d1, r1x)), _mm_mul_pd(d2, r2x)), _mm_mul_pd(sd, _mm_add_pd(_mm_add_pd(r0x, r1x), r2x)));
+        __m128d sy = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(d0, r0y), _mm_mul_pd(d1, r1y)), _mm_mul_pd(d2, r2y)), _mm_mul_pd(sd, _mm_add_pd(_mm_add_pd(r0y, r1y), r2y)));
+        __m128d sz = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(d0, r0z), _mm_mul_pd(d1, r1z)), _mm_mul_pd(d2, r2z)), _mm_mul_pd(sd, _mm_add_pd(_mm_add_pd(r0z, r1z), r2z)));
+
+        fx = _mm_add_pd(fx, _mm_mul_pd(sd, nx));
+        fy = _mm_add_pd(fy, _mm_mul_pd(sd, ny));
+        fz = _mm_add_pd(fz, _mm_mul_pd(sd, nz));
+        tx = _mm_add_pd(tx, _mm_sub_pd(_mm_mul_pd(sy, nz), _mm_mul_pd(sz, ny)));
+        ty = _mm_add_pd(ty, _mm_sub_pd(_mm_mul_pd(sz, nx), _mm_mul_pd(sx, nz)));
+        tz = _mm_add_pd(tz, _mm_sub_pd(_mm_mul_pd(sx, ny), _mm_mul_pd(sy, nx)));
+    }
+
+    double lanes[2];
+    __m128d acc[6] = {fx, fy, fz, tx, ty, tz};
+    double *out[6] = {&sums.f[0], &sums.f[1], &sums.f[2], &sums.t[0], &sums.t[1], &sums.t[2]};
+    for (int c = 0; c < 6; c++)
+    {
+        _mm_storeu_pd(lanes, acc[c]);
+        *out[c] += lanes[0] + lanes[1];
+    }
+
+    sums_crossing(h, crossing, sums);
+    // Remaining triangles
+    sums_scalar(h, k, end, sums);
+}
+
+
+__attribute__((target("avx2")))
+static void sums_avx2(const HullView& h, int begin, int end, HullSums& sums)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d level = _mm256_set1_pd(h.level);
+    const __m256d offx = _mm256_set1_pd(h.offx), offy = _mm256_set1_pd(h.offy), offz = _mm256_set1_pd(h.offz);
+    const __m256d upx = _mm256_set1_pd(h.upx), upy = _mm256_set1_pd(h.upy), upz = _mm256_set1_pd(h.upz);
+    __m256d fx = zero, fy = zero, fz = zero, tx = zero, ty = zero, tz = zero;
+    std::vector<int> crossing;
+
+    int k = begin;
+    for (; k + 4 <= end; k += 4)
+    {
+        __m256d v0x = _mm256_loadu_pd(h.ax + k), v0y = _mm256_loadu_pd(h.ay + k), v0z = _mm256_loadu_pd(h.az + k);
+        __m256d v1x = _mm256_loadu_pd(h.bx + k), v1y = _mm256_loadu_pd(h.by + k), v1z = _mm256_loadu_pd(h.bz + k);
+        __m256d v2x = _mm256_loadu_pd(h.cx + k), v2y = _mm256_loadu_pd(h.cy + k), v2z = _mm256_loadu_pd(h.cz + k);
+        __m256d d0 = _mm256_sub_pd(level, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(upx, v0x), _mm256_mul_pd(upy, v0y)), _mm256_mul_pd(upz, v0z)));
+        __m256d d1 = _mm256_sub_pd(level, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(upx, v1x), _mm256_mul_pd(upy, v1y)), _mm256_mul_pd(upz, v1z)));
+        __m256d d2 = _mm256_sub_pd(level, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(upx, v2x), _mm256_mul_pd(upy, v2y)), _mm256_mul_pd(upz, v2z)));
+
+        __m256d in0 = _mm256_cmp_pd(d0, zero, _CMP_GE_OQ), in1 = _mm256_cmp_pd(d1, zero, _CMP_GE_OQ), in2 = _mm256_cmp_pd(d2, zero, _CMP_GE_OQ);
+        __m256d full = _mm256_and_pd(_mm256_and_pd(in0, in1), in2);
+        __m256d any = _mm256_or_pd(_mm256_or_pd(in0, in1), in2);
+        int fullMask = _mm256_movemask_pd(full);
+        int crossMask = _mm256_movemask_pd(_mm256_andnot_pd(full, any));
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (crossMask & (1 << lane))
+            {
+                crossing.push_back(k + lane);
+            }
+        }
+        if (fullMask == 0)
+        {
+            continue;
+        }
+
+        __m256d r0x = _mm256_add_pd(v0x, offx), r0y = _mm256_add_pd(v0y, offy), r0z = _mm256_add_pd(v0z, offz);
+        __m256d r1x = _mm256_add_pd(v1x, offx), r1y = _mm256_add_pd(v1y, offy), r1z = _mm256_add_pd(v1z, offz);
+        __m256d r2x = _mm256_add_pd(v2x, offx), r2y = _mm256_add_pd(v2y, offy), r2z = _mm256_add_pd(v2z, offz);
+        __m256d e1x = _mm256_sub_pd(r1x, r0x), e1y = _mm256_sub_pd(r1y, r0y), e1z = _mm256_sub_pd(r1z, r0z);
+        __m256d e2x = _mm256_sub_pd(r2x, r0x), e2y = _mm256_sub_pd(r2y, r0y), e2z = _mm256_sub_pd(r2z, r0z);
+        __m256d nx = _mm256_sub_pd(_mm256_mul_pd(e1y, e2z), _mm256_mul_pd(e1z, e2y));
+        __m256d ny = _mm256_sub_pd(_mm256_mul_pd(e1z, e2x), _mm256_mul_pd(e1x, e2z));
+        __m256d nz = _mm256_sub_pd(_mm256_mul_pd(e1x, e2y), _mm256_mul_pd(e1y, e2x));
+
+        // Non submerged lanes weigh 0
+        __m256d sd = _mm256_and_pd(full, _mm256_add_pd(_mm256_add_pd(d0, d1), d2));
+        d0 = _mm256_and_pd(full, d0);
+        d1 = _mm256_and_pd(full, d1);
+        d2 = _mm256_and_pd(full, d2);
+        __m256d sx = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(d0, r0x), _mm256_mul_pd(d1, r1x)), _mm256_mul_pd(d2, r2x)), _mm256_mul_pd(sd, _mm256_add_pd(_mm256_add_pd(r0x, r1x), r2x)));
+        __m256d sy = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(d0, r0y), _mm256_mul_pd(d1, r1y)), _mm256_mul_pd(d2, r2y)), _mm256_mul_pd(sd, _mm256_add_pd(_mm256_add_pd(r0y, r1y), r2y)));
+        __m256d sz = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(d0, r0z), _mm256_mul_pd(d1, r1z)), _mm256_mul_pd(d2, r2z)), _mm256_mul_pd(sd, _mm256_add_pd(_mm256_add_pd(r0z, r1z), r2z)));
+
+        fx = _mm256_add_pd(fx, _mm256_mul_pd(sd, nx));
+        fy = _mm256_add_pd(fy, _mm256_mul_pd(sd, ny));
+        fz = _mm256_add_pd(fz, _mm256_mul_pd(sd, nz));
+        tx = _mm256_add_pd(tx, _mm256_sub_pd(_mm256_mul_pd(sy, nz), _mm256_mul_pd(sz, ny)));
+        ty = _mm256_add_pd(ty, _mm256_sub_pd(_mm256_mul_pd(sz, nx), _mm256_mul_pd(sx, nz)));
+        tz = _mm256_add_pd(tz, _mm256_sub_pd(_mm256_mul_pd(sx, ny), _mm256_mul_pd(sy, nx)));
+    }
+
+    double lanes[4];
+    __m256d acc[6] = {fx, fy, fz, tx, ty, tz};
+    double *out[6] = {&sums.f[0], &sums.f[1], &sums.f[2], &sums.t[0], &sums.t[1], &sums.t[2]};
+    for (int c = 0; c < 6; c++)
+    {
+        _mm256_storeu_pd(lanes, acc[c]);
+        *out[c] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    sums_crossing(h, crossing, sums);
+    // Remaining triangles
+    sums_scalar(h, k, end, sums);
+}
+
+#endif
+
+
+HullForces Hull::hydrostatic(const Point& origin, const Quaternion& orientation, double waterLevel, const Point& center, int begin, int end) const
+{
+    // Vertical and torque center in the body coordinates
+    Vector up = orientation.inverseRotate(Vector(0, 1, 0));
+    Vector off = orientation.inverseRotate(Vector(center, origin));
+
+    HullView h;
+    h.ax = ax.data(); h.ay = ay.data(); h.az = az.data();
+    h.bx = bx.data(); h.by = by.data(); h.bz = bz.data();
+    h.cx = cx.data(); h.cy = cy.data(); h.cz = cz.data();
+    h.offx = off.x;
+    h.offy = off.y;
+    h.offz = off.z;
+    h.upx = up.x;
+    h.upy = up.y;
+    h.upz = up.z;
+    h.level = waterLevel - origin.y;
+
+    HullSums sums;
+#ifdef KERNEL_X86
+    switch(get_kernel_level())
+    {
+    case KERNEL_AVX2:
+        sums_avx2(h, begin, end, sums);
+        break;
+    case KERNEL_SSE2:
+        sums_sse2(h, begin, end, sums);
+        break;
+    default:
+        sums_scalar(h, begin, end, sums);
+        break;
+    }
+#else
+    sums_scalar(h, begin, end, sums);
+#endif
+
+    double pressure = WATER_DENSITY * GRAVITY;
+    HullForces forces;
+    Vector force(-pressure / 6.0 * sums.f[0], -pressure / 6.0 * sums.f[1], -pressure / 6.0 * sums.f[2]);
+    Vector torque(-pressure / 24.0 * sums.t[0], -pressure / 24.0 * sums.t[1], -pressure / 24.0 * sums.t[2]);
+    // Back to the world coordinates, the force is vertical for a closed hull
+    forces.force = orientation.rotate(force);
+    forces.torque = orientation.rotate(torque);
+    forces.volume = force * up / pressure;
+    return forces;
+}
+
+
+HullForces Hull::hydrostatic(const Point& origin, const Quaternion& orientation, double waterLevel, const Point& center) const
+{
+    // Same chunks as the parallel version
+    HullForces forces;
+    for (int begin = 0; begin < size(); begin += HULL_GRAIN)
+    {
+        forces += hydrostatic(origin, orientation, waterLevel, center, begin, std::min(begin + HULL_GRAIN, size()));
+    }
+    return forces;
+}
+
+
+HullForces Hull::hydrostatic(const Point& origin, const Quaternion& orientation, double waterLevel, const Point& center, ThreadPool& pool) const
+{
+    int chunk = pool.chunkSize(size(), HULL_GRAIN);
+    std::vector<HullForces> partial((size() + chunk - 1) / chunk);
+    pool.parallelFor(size(), HULL_GRAIN, [this, &origin, &orientation, waterLevel, &center, chunk, &partial](int begin, int end)
+    {
+        partial[begin / chunk] = hydrostatic(origin, orientation, waterLevel, center, begin, end);
+    });
+
+    // Partial sums added in chunk order
+    HullForces forces;
+    for (size_t c = 0; c < partial.size(); c++)
+    {
+        forces += partial[c];
+    }
+    return forces;
+}
@@ -0,0 +1,227 @@
+#include <cmath>
+#include <algorithm>
+#include "integrator.h"
+
+
+// State of a body as 6 numbers : position then speed
+// Derivative : speed then acceleration
+static void derivative(const ForceModel& model, const double y[6], double dy[6])
+{
+    Vector acc = model.acceleration(Point(y[0], y[1], y[2]), Vector(y[3], y[4], y[5]));
+    dy[0] = y[3];
+    dy[1] = y[4];
+    dy[2] = y[5];
+    dy[3] = acc.x;
+    dy[4] = acc.y;
+    dy[5] = acc.z;
+}
+
+
+void EulerIntegrator::step(const ForceModel& model, Point& pos, Vector& spd, double delta_t)
+{
+    // Same operations as buoyancy_step
+    Vector acc = model.acceleration(pos, spd);
+    evaluations++;
+    spd = spd + delta_t * acc;
+    pos.translate(delta_t * spd);
+}
+
+
+void VerletIntegrator::step(const ForceModel& model, Point& pos, Vector& spd, double delta_t)
+{
+    Vector half = spd + 0.5 * delta_t * model.acceleration(pos, spd);
+    pos.translate(delta_t * half);
+    // Drag at the half step speed
+    spd = half + 0.5 * delta_t * model.acceleration(pos, half);
+    evaluations += 2;
+}
+
+
+void RK4Integrator::step(const ForceModel& model, Point& pos, Vector& spd, double delta_t)
+{
+    double y[6] = {pos.x, pos.y, pos.z, spd.x, spd.y, spd.z};
+    double k1[6], k2[6], k3[6], k4[6], tmp[6];
+
+    derivative(model, y, k1);
+    for (int i = 0; i < 6; i++) tmp[i] = y[i] + 0.5 * delta_t * k1[i];
+    derivative(model, tmp, k2);
+    for (int i = 0; i < 6; i++) tmp[i] = y[i] + 0.5 * delta_t * k2[i];
+    derivative(model, tmp, k3);
+    for (int i = 0; i < 6; i++) tmp[i] = y[i] + delta_t * k3[i];
+    derivative(model, tmp, k4);
+    evaluations += 4;
+
+    for (int i = 0; i < 6; i++)
+    {
+        y[i] += delta_t / 6.0 * (k1[i] + 2.0 * k2[i] + 2.0 * k3[i] + k4[i]);
+    }
+    pos = Point(y[0], y[1], y[2]);
+    spd = Vector(y[3], y[4], y[5]);
+}
+
+
+// Dormand-Prince tableau
+static const double DP_A[7][6] = {
+    {0, 0, 0, 0, 0, 0},
+    {1.0 / 5, 0, 0, 0, 0, 0},
+    {3.0 / 40, 9.0 / 40, 0, 0, 0, 0},
+    {44.0 / 45, -56.0 / 15, 32.0 / 9, 0, 0, 0},
+    {19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729, 0, 0},
+    {9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656, 0},
+    {35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84}
+};
+
+// Fifth order solution minus the embedded fourth order one
+static const double DP_E[7] = {
+    35.0 / 384 - 5179.0 / 57600, 0, 500.0 / 1113 - 7571.0 / 16695, 125.0 / 192 - 393.0 / 640,
+    -2187.0 / 6784 + 92097.0 / 339200, 11.0 / 84 - 187.0 / 2100, -1.0 / 40
+};
+
+
+void RK45Integrator::advance(const ForceModel& model)
+{
+    // From the end of the last step, its last stage is the first one of this step
+    std::copy(end, end + 6, start);
+    std::copy(slope[1], slope[1] + 6, slope[0]);
+    double k[7][6], next[6];
+    std::copy(slope[0], slope[0] + 6, k[0]);
+
+    double h = guess;
+    for (;;)
+    {
+        // Stages, the last one is the derivative at the new state
+        for (int s = 1; s < 7; s++)
+        {
+            for (int i = 0; i < 6; i++)
+            {
+                double sum = 0.0;
+                for (int j = 0; j < s; j++)
+                {
+                    sum += DP_A[s][j] * k[j][i];
+                }
+                next[i] = start[i] + h * sum;
+            }
+            derivative(model, next, k[s]);
+        }
+        evaluations += 6;
+
+        // Error relative to the tolerance
+        double error = 0.0;
+        for (int i = 0; i < 6; i++)
+        {
+            double e = 0.0;
+            for (int j = 0; j < 7; j++)
+            {
+                e += DP_E[j] * k[j][i];
+            }
+            double scale = RK45_TOLERANCE * (1.0 + std::max(fabs(start[i]), fabs(next[i])));
+            error = std::max(error, fabs(h * e) / scale);
+        }
+
+        // Next step length, within a factor 5 of this one
+        double factor = error > 0.0 ? std::min(std::max(0.9 * pow(error, -0.2), 0.2), 5.0) : 5.0;
+        if (error <= 1.0 || h <= RK45_MIN_STEP)
+        {
+            span = h;
+            std::copy(next, next + 6, end);
+            std::copy(k[6], k[6] + 6, slope[1]);
+            guess = std::min(std::max(h * factor, RK45_MIN_STEP), RK45_MAX_STEP);
+            steps++;
+            return;
+        }
+        rejected++;
+        h = std::max(h * factor, RK45_MIN_STEP);
+    }
+}
+
+
+void RK45Integrator::step(const ForceModel& model, Point& pos, Vector& spd, double delta_t)
+{
+    double y[6] = {pos.x, pos.y, pos.z, spd.x, spd.y, spd.z};
+
+    // First call : the steps start from the state of the body
+    if (span == 0.0)
+    {
+        std::copy(y, y + 6, end);
+        derivative(model, end, slope[1]);
+        evaluations++;
+        elapsed = 0.0;
+        if (guess == 0.0)
+        {
+            guess = std::min(delta_t, RK45_MAX_STEP);
+        }
+    }
+    // The body was moved since the last call (collisions) : the rest of the step starts from its state,
+    // its end moved by the same correction, the speed one carried over the remaining time
+    // Only the interpolation starts again, the accepted step and the next step length are kept
+    else if (!std::equal(y, y + 6, given))
+    {
+        double remaining = span - elapsed;
+        for (int i = 0; i < 3; i++)
+        {
+            double speedChange = y[i + 3] - given[i + 3];
+            end[i] += y[i] - given[i] + remaining * speedChange;
+            end[i + 3] += speedChange;
+            slope[1][i] = end[i + 3];
+        }
+        std::copy(y, y + 6, start);
+        derivative(model, start, slope[0]);
+        evaluations++;
+        span = remaining;
+        elapsed = 0.0;
+    }
+
+    // Steps until the one covering the time reached
+    elapsed += delta_t;
+    while (elapsed > span)
+    {
+        elapsed -= span;
+        advance(model);
+    }
+
+    // Cubic Hermite interpolation in the step, from the states and derivatives at both ends
+    double a = elapsed / span;
+    double h00 = (1.0 + 2.0 * a) * (1.0 - a) * (1.0 - a);
+    double h10 = a * (1.0 - a) * (1.0 - a);
+    double h01 = a * a * (3.0 - 2.0 * a);
+    double h11 = a * a * (a - 1.0);
+    for (int i = 0; i < 6; i++)
+    {
+        given[i] = h00 * start[i] + h10 * span * slope[0][i] + h01 * end[i] + h11 * span * slope[1][i];
+    }
+
+    pos = Point(given[0], given[1], given[2]);
+    spd = Vector(given[3], given[4], given[5]);
+}
+
+
+Integrator* create_integrator(IntegratorType type)
+{
+    switch(type)
+    {
+    case INTEGRATOR_VERLET:
+        return new VerletIntegrator();
+    case INTEGRATOR_RK4:
+        return new RK4Integrator();
+    case INTEGRATOR_RK45:
+        return new RK45Integrator();
+    default:
+        return new EulerIntegrator();
+    }
+}
+
+
+const char* integrator_name(IntegratorType type)
+{
+    switch(type)
+    {
+    case INTEGRATOR_VERLET:
+        return "verlet";
+    case INTEGRATOR_RK4:
+        return "rk4";
+    case INTEGRATOR_RK45:
+        return "rk45";
+    default:
+        return "euler";
+    }
+}
@@ -0,0 +1,241 @@
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include "kernel.h"
+#include "physics.h"
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_X86
+#include <immintrin.h>
+#endif
+
+
+// Unknown until the first call, which can come from several pool threads at once
+static std::atomic<int> kernelLevel(-1);
+
+
+KernelLevel detect_kernel_level()
+{
+#ifdef KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return KERNEL_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return KERNEL_SSE2;
+    }
+#endif
+    return KERNEL_SCALAR;
+}
+
+
+KernelLevel get_kernel_level()
+{
+    int level = kernelLevel.load();
+    if (level < 0)
+    {
+        // Only the first detection is kept, never overwrites set_kernel_level
+        int detected = detect_kernel_level();
+        level = kernelLevel.compare_exchange_strong(level, detected) ? detected : level;
+    }
+    return (KernelLevel)level;
+}
+
+
+void set_kernel_level(KernelLevel level)
+{
+    // Never use an instruction set the CPU doesn't have
+    kernelLevel = std::min(level, detect_kernel_level());
+}
+
+
+const char* kernel_level_name(KernelLevel level)
+{
+    switch(level)
+    {
+    case KERNEL_AVX2:
+        return "avx2";
+    case KERNEL_SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+
+void buoyancy_step(BodyArrays& bodies, double delta_t)
+{
+    buoyancy_step(bodies, delta_t, 0, bodies.count);
+}
+
+
+void buoyancy_step(BodyArrays& bodies, double delta_t, int begin, int end)
+{
+    switch(get_kernel_level())
+    {
+    case KERNEL_AVX2:
+        buoyancy_step_avx2(bodies, delta_t, begin, end);
+        break;
+    case KERNEL_SSE2:
+        buoyancy_step_sse2(bodies, delta_t, begin, end);
+        break;
+    default:
+        buoyancy_step_scalar(bodies, delta_t, begin, end);
+        break;
+    }
+}
+
+
+// Model, for a sphere of bottom height b :
+//  t = clamp((level - b) / 2r, 0, 1), f = t^2 (3 - 2t) is the submerged portion
+//  (spherical cap, see submerged_portion)
+//  a = (buoyancy + weight + drag) / m, drag = -1/2 rho Cd pi r^2 f |v| v
+//  v' = v + dt * a
+//  p' = p + dt * v'
+// Same operations as EulerIntegrator with SphereForces
+// No branch : operations are done in the same order so that all versions give the same results
+void buoyancy_step_scalar(BodyArrays& bodies, double delta_t, int begin, int end)
+{
+    const double level = WATER_LEVEL;
+    const double buoyancyFactor = WATER_DENSITY * GRAVITY;
+    const double dragFactor = 0.5 * WATER_DENSITY * DRAG_COEFFICIENT * M_PI;
+
+    for (int i = begin; i < end; i++)
+    {
+        double r = bodies.radius[i];
+        double invMass = bodies.invMass[i];
+        double vx = bodies.vx[i], vy = bodies.vy[i], vz = bodies.vz[i];
+
+        double depth = level - (bodies.py[i] - r);
+        double portion = submerged_portion(depth, r);
+        double lift = buoyancyFactor * bodies.volume[i] * portion * invMass;
+        double speed = sqrt(vx * vx + vy * vy + vz * vz);
+        double drag = dragFactor * r * r * portion * speed * invMass;
+
+        double nvx = vx + delta_t * -(drag * vx);
+        double nvy = vy + delta_t * ((lift - GRAVITY) + -(drag * vy));
+        double nvz = vz + delta_t * -(drag * vz);
+
+        bodies.px[i] += delta_t * nvx;
+        bodies.py[i] += delta_t * nvy;
+        bodies.pz[i] += delta_t * nvz;
+        bodies.vx[i] = nvx;
+        bodies.vy[i] = nvy;
+        bodies.vz[i] = nvz;
+    }
+}
+
+
+#ifdef KERNEL_X86
+
+__attribute__((target("sse2")))
+void buoyancy_step_sse2(BodyArrays& bodies, double delta_t, int begin, int end)
+{
+    const __m128d level = _mm_set1_pd(WATER_LEVEL);
+    const __m128d buoyancyFactor = _mm_set1_pd(WATER_DENSITY * GRAVITY);
+    const __m128d gravity = _mm_set1_pd(GRAVITY);
+    const __m128d dt = _mm_set1_pd(delta_t);
+    const __m128d dragFactor = _mm_set1_pd(0.5 * WATER_DENSITY * DRAG_COEFFICIENT * M_PI);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d two = _mm_set1_pd(2.0);
+    const __m128d three = _mm_set1_pd(3.0);
+
+    int i = begin;
+    for (; i + 2 <= end; i += 2)
+    {
+        __m128d r = _mm_loadu_pd(bodies.radius + i);
+        __m128d invMass = _mm_loadu_pd(bodies.invMass + i);
+        __m128d vx = _mm_loadu_pd(bodies.vx + i);
+        __m128d vy = _mm_loadu_pd(bodies.vy + i);
+        __m128d vz = _mm_loadu_pd(bodies.vz + i);
+
+        __m128d depth = _mm_sub_pd(level, _mm_sub_pd(_mm_loadu_pd(bodies.py + i), r));
+        __m128d t = _mm_min_pd(_mm_max_pd(_mm_div_pd(depth, _mm_mul_pd(two, r)), zero), one);
+        __m128d portion = _mm_mul_pd(_mm_mul_pd(t, t), _mm_sub_pd(three, _mm_mul_pd(two, t)));
+        __m128d lift = _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(buoyancyFactor, _mm_loadu_pd(bodies.volume + i)), portion), invMass);
+
+        __m128d speed = _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(vx, vx), _mm_mul_pd(vy, vy)), _mm_mul_pd(vz, vz)));
+        __m128d drag = _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(_mm_mul_pd(_mm_mul_pd(dragFactor, r), r), portion), speed), invMass);
+        __m128d nvx = _mm_add_pd(vx, _mm_mul_pd(dt, _mm_sub_pd(zero, _mm_mul_pd(drag, vx))));
+        __m128d nvy = _mm_add_pd(vy, _mm_mul_pd(dt, _mm_add_pd(_mm_sub_pd(lift, gravity), _mm_sub_pd(zero, _mm_mul_pd(drag, vy)))));
+        __m128d nvz = _mm_add_pd(vz, _mm_mul_pd(dt, _mm_sub_pd(zero, _mm_mul_pd(drag, vz))));
+
+        _mm_storeu_pd(bodies.px + i, _mm_add_pd(_mm_loadu_pd(bodies.px + i), _mm_mul_pd(dt, nvx)));
+        _mm_storeu_pd(bodies.py + i, _mm_add_pd(_mm_loadu_pd(bodies.py + i), _mm_mul_pd(dt, nvy)));
+        _mm_storeu_pd(bodies.pz + i, _mm_add_pd(_mm_loadu_pd(bodies.pz + i), _mm_mul_pd(dt, nvz)));
+        _mm_storeu_pd(bodies.vx + i, nvx);
+        _mm_storeu_pd(bodies.vy + i, nvy);
+        _mm_storeu_pd(bodies.vz + i, nvz);
+    }
+
+    // Remaining bodies
+    buoyancy_step_scalar(bodies, delta_t, i, end);
+}
+
+
+__attribute__((target("avx2")))
+void buoyancy_step_avx2(BodyArrays& bodies, double delta_t, int begin, int end)
+{
+    const __m256d level = _mm256_set1_pd(WATER_LEVEL);
+    const __m256d buoyancyFactor = _mm256_set1_pd(WATER_DENSITY * GRAVITY);
+    const __m256d gravity = _mm256_set1_pd(GRAVITY);
+    const __m256d dt = _mm256_set1_pd(delta_t);
+    const __m256d dragFactor = _mm256_set1_pd(0.5 * WATER_DENSITY * DRAG_COEFFICIENT * M_PI);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d three = _mm256_set1_pd(3.0);
+
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m256d r = _mm256_loadu_pd(bodies.radius + i);
+        __m256d invMass = _mm256_loadu_pd(bodies.invMass + i);
+        __m256d vx = _mm256_loadu_pd(bodies.vx + i);
+        __m256d vy = _mm256_loadu_pd(bodies.vy + i);
+        __m256d vz = _mm256_loadu_pd(bodies.vz + i);
+
+        __m256d depth = _mm256_sub_pd(level, _mm256_sub_pd(_mm256_loadu_pd(bodies.py + i), r));
+        __m256d t = _mm256_min_pd(_mm256_max_pd(_mm256_div_pd(depth, _mm256_mul_pd(two, r)), zero), one);
+        __m256d portion = _mm256_mul_pd(_mm256_mul_pd(t, t), _mm256_sub_pd(three, _mm256_mul_pd(two, t)));
+        __m256d lift = _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(buoyancyFactor, _mm256_loadu_pd(bodies.volume + i)), portion), invMass);
+
+        __m256d speed = _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(vx, vx), _mm256_mul_pd(vy, vy)), _mm256_mul_pd(vz, vz)));
+        __m256d drag = _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(dragFactor, r), r), portion), speed), invMass);
+        __m256d nvx = _mm256_add_pd(vx, _mm256_mul_pd(dt, _mm256_sub_pd(zero, _mm256_mul_pd(drag, vx))));
+        __m256d nvy = _mm256_add_pd(vy, _mm256_mul_pd(dt, _mm256_add_pd(_mm256_sub_pd(lift, gravity), _mm256_sub_pd(zero, _mm256_mul_pd(drag, vy)))));
+        __m256d nvz = _mm256_add_pd(vz, _mm256_mul_pd(dt, _mm256_sub_pd(zero, _mm256_mul_pd(drag, vz))));
+
+        _mm256_storeu_pd(bodies.px + i, _mm256_add_pd(_mm256_loadu_pd(bodies.px + i), _mm256_mul_pd(dt, nvx)));
+        _mm256_storeu_pd(bodies.py + i, _mm256_add_pd(_mm256_loadu_pd(bodies.py + i), _mm256_mul_pd(dt, nvy)));
+        _mm256_storeu_pd(bodies.pz + i, _mm256_add_pd(_mm256_loadu_pd(bodies.pz + i), _mm256_mul_pd(dt, nvz)));
+        _mm256_storeu_pd(bodies.vx + i, nvx);
+        _mm256_storeu_pd(bodies.vy + i, nvy);
+        _mm256_storeu_pd(bodies.vz + i, nvz);
+    }
+
+    // Remaining bodies
+    buoyancy_step_scalar(bodies, delta_t, i, end);
+}
+
+#else
+
+// No vector instruction set on this platform
+void buoyancy_step_sse2(BodyArrays& bodies, double delta_t, int begin, int end)
+{
+    buoyancy_step_scalar(bodies, delta_t, begin, end);
+}
+
+
+void buoyancy_step_avx2(BodyArrays& bodies, double delta_t, int begin, int end)
+{
+    buoyancy_step_scalar(bodies, delta_t, begin, end);
+}
+
+#endif
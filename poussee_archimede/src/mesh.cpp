@@ -0,0 +1,153 @@
+#include <cmath>
+#include "mesh.h"
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+Mesh::Mesh()
+{
+    vertexBuffer = 0;
+    indexBuffer = 0;
+    deleteBuffers = NULL;
+}
+
+
+Mesh::~Mesh()
+{
+    release();
+}
+
+
+void Mesh::clear()
+{
+    vertices.clear();
+    normals.clear();
+    indices.clear();
+}
+
+
+GLuint Mesh::addVertex(GLfloat x, GLfloat y, GLfloat z, GLfloat nx, GLfloat ny, GLfloat nz)
+{
+    vertices.push_back(x);
+    vertices.push_back(y);
+    vertices.push_back(z);
+    normals.push_back(nx);
+    normals.push_back(ny);
+    normals.push_back(nz);
+
+    return (GLuint)(vertices.size() / 3 - 1);
+}
+
+
+void Mesh::addTriangle(GLuint i1, GLuint i2, GLuint i3)
+{
+    indices.push_back(i1);
+    indices.push_back(i2);
+    indices.push_back(i3);
+}
+
+
+void Mesh::release()
+{
+    if (vertexBuffer != 0)
+    {
+        deleteBuffers(1, &vertexBuffer);
+        vertexBuffer = 0;
+    }
+    if (indexBuffer != 0)
+    {
+        deleteBuffers(1, &indexBuffer);
+        indexBuffer = 0;
+    }
+}
+
+
+void Mesh::buildSphere(int slices, int stacks)
+{
+    clear();
+
+    // Rings from the north pole (+y) to the south pole (-y)
+    // The first and last vertex of a ring are at the same place, for the seam
+    for (int i = 0; i <= stacks; i++)
+    {
+        double theta = M_PI * i / stacks;
+        for (int j = 0; j <= slices; j++)
+        {
+            double phi = 2 * M_PI * j / slices;
+            GLfloat x = (GLfloat)(sin(theta) * sin(phi));
+            GLfloat y = (GLfloat)cos(theta);
+            GLfloat z = (GLfloat)(sin(theta) * cos(phi));
+            // On a unit sphere, the normal is the position
+            addVertex(x, y, z, x, y, z);
+        }
+    }
+
+    // Two triangles per quad, counter clockwise seen from outside
+    for (int i = 0; i < stacks; i++)
+    {
+        for (int j = 0; j < slices; j++)
+        {
+            GLuint a = i * (slices + 1) + j;
+            GLuint b = a + slices + 1;
+            if (i > 0)
+            {
+                addTriangle(a, b, a + 1);
+            }
+            if (i < stacks - 1)
+            {
+                addTriangle(a + 1, b, b + 1);
+            }
+        }
+    }
+}
+
+
+// Camera for the levels of detail
+static Point lodEye(0, 0, 5);
+static double lodPixelsPerUnit = 1000.0; // Pixels for a unit length at a unit distance
+
+
+void set_lod_view(const Point& eye, double fovy, int viewport_height)
+{
+    lodEye = eye;
+    lodPixelsPerUnit = 0.5 * viewport_height / tan(0.5 * fovy * M_PI / 180.0);
+}
+
+
+double projected_radius(const Point& center, double radius)
+{
+    double d = distance(center, lodEye);
+    if (d <= radius)
+    {
+        // Camera inside the sphere
+        return lodPixelsPerUnit;
+    }
+    return radius * lodPixelsPerUnit / d;
+}
+
+
+int select_sphere_lod(double screen_radius, int current_lod)
+{
+    // About one slice per pixel of radius : edges of ~6 pixels on screen
+    double slices = screen_radius;
+
+    if (current_lod >= 0 && current_lod < SPHERE_LOD_COUNT)
+    {
+        // Bounds of the current level, widened by the hysteresis margin
+        double low = current_lod > 0 ? SPHERE_LOD_SLICES[current_lod - 1] * (1.0 - SPHERE_LOD_HYSTERESIS) : 0.0;
+        double high = SPHERE_LOD_SLICES[current_lod] * (1.0 + SPHERE_LOD_HYSTERESIS);
+        if ((slices > low && slices <= high) || (current_lod == SPHERE_LOD_COUNT - 1 && slices > low))
+        {
+            return current_lod;
+        }
+    }
+
+    // Coarsest level with enough slices
+    int lod = 0;
+    while (lod < SPHERE_LOD_COUNT - 1 && SPHERE_LOD_SLICES[lod] < slices)
+    {
+        lod++;
+    }
+    return lod;
+}
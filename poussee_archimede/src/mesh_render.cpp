@@ -0,0 +1,84 @@
+#include "mesh.h"
+#include "gl_ext.h"
+
+
+// Vertex buffers and drawing of the meshes, only built with the OpenGL targets
+
+
+void Mesh::upload()
+{
+    if (!has_vertex_buffers() || vertices.empty())
+    {
+        return;
+    }
+    release();
+    deleteBuffers = pglDeleteBuffers;
+
+    // Vertices then normals in the same buffer
+    std::vector<GLfloat> data(vertices);
+    data.insert(data.end(), normals.begin(), normals.end());
+    pglGenBuffers(1, &vertexBuffer);
+    pglBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    pglBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(GLfloat), data.data(), GL_STATIC_DRAW);
+
+    pglGenBuffers(1, &indexBuffer);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    pglBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+
+void Mesh::draw() const
+{
+    if (indices.empty())
+    {
+        return;
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    if (vertexBuffer != 0)
+    {
+        pglBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glVertexPointer(3, GL_FLOAT, 0, (const GLvoid*)0);
+        glNormalPointer(GL_FLOAT, 0, (const GLvoid*)(vertices.size() * sizeof(GLfloat)));
+        glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, (const GLvoid*)0);
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    else
+    {
+        glVertexPointer(3, GL_FLOAT, 0, vertices.data());
+        glNormalPointer(GL_FLOAT, 0, normals.data());
+        glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, indices.data());
+    }
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+
+const Mesh& get_sphere_mesh(int lod)
+{
+    static Mesh meshes[SPHERE_LOD_COUNT];
+
+    if (lod < 0)
+    {
+        lod = 0;
+    }
+    if (lod >= SPHERE_LOD_COUNT)
+    {
+        lod = SPHERE_LOD_COUNT - 1;
+    }
+
+    Mesh& mesh = meshes[lod];
+    if (mesh.getTriangleCount() == 0)
+    {
+        mesh.buildSphere(SPHERE_LOD_SLICES[lod], SPHERE_LOD_SLICES[lod] / 2);
+        mesh.upload();
+    }
+    return mesh;
+}
+
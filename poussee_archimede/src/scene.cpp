@@ -0,0 +1,473 @@
+#include <cmath>
+#include "scene.h"
+#include "physics.h"
+
+
+void Scene::setPlace(FormHandle handle, int place)
+{
+    if ((int)places.size() <= handle.index)
+    {
+        places.resize(handle.index + 1);
+    }
+    places[handle.index] = place;
+}
+
+
+void Scene::detachSphere(int place)
+{
+    Sphere *sphere = spheres.forms[place];
+    if (sphere->getFluid() != NULL)
+    {
+        sphere->getFluid()->removeBody(sphere->getFluidBody());
+    }
+
+    // The bodies follow the spheres : the last one takes the place of the removed one
+    int last = spheres.size() - 1;
+    collisions.dropBody(place);
+    if (place != last)
+    {
+        collisions.moveBody(last, place);
+    }
+}
+
+
+void Scene::detachSurface(Surface *surface)
+{
+    for (int i = 0; i < spheres.size(); i++)
+    {
+        if (surface->getWaves() != NULL && spheres.forms[i]->getWaves() == surface->getWaves())
+        {
+            spheres.forms[i]->setWaves(NULL);
+        }
+    }
+}
+
+
+void Scene::detachFluid(Fluid *fluid)
+{
+    for (int i = 0; i < spheres.size(); i++)
+    {
+        if (spheres.forms[i]->getFluid() == &fluid->getFluid())
+        {
+            spheres.forms[i]->setFluid(NULL, 0);
+        }
+    }
+}
+
+
+bool Scene::remove(FormHandle handle)
+{
+    Form *form = arena.get(handle);
+    if (form == NULL)
+    {
+        return false;
+    }
+
+    int place = places[handle.index];
+    FormHandle moved;
+    switch (arena.getType(handle))
+    {
+    case FORM_SPHERE:
+        detachSphere(place);
+        moved = spheres.remove(place);
+        break;
+    case FORM_CUBE_FACE:
+        moved = faces.remove(place);
+        break;
+    case FORM_SURFACE:
+        detachSurface(static_cast<Surface*>(form));
+        moved = surfaces.remove(place);
+        break;
+    case FORM_FLUID:
+        detachFluid(static_cast<Fluid*>(form));
+        moved = fluids.remove(place);
+        break;
+    }
+    if (!moved.isNull())
+    {
+        places[moved.index] = place;
+    }
+    arena.destroy(handle);
+    return true;
+}
+
+
+void Scene::clear()
+{
+    // No body left for the contacts of the last step
+    collisions.renumberBodies(std::vector<int>(spheres.size(), -1));
+    arena.clear();
+    spheres.clear();
+    faces.clear();
+    surfaces.clear();
+    fluids.clear();
+    places.clear();
+    last = FormHandle();
+}
+
+
+Form* Scene::getForm(int i) const
+{
+    if (i < spheres.size())
+    {
+        return spheres.forms[i];
+    }
+    i -= spheres.size();
+    if (i < faces.size())
+    {
+        return faces.forms[i];
+    }
+    i -= faces.size();
+    if (i < surfaces.size())
+    {
+        return surfaces.forms[i];
+    }
+    i -= surfaces.size();
+    return fluids.forms[i];
+}
+
+
+int create_scene(Scene& scene, IntegratorType integrator, BroadPhaseType broad_phase, WaterModel water)
+{
+    // The forms of a previous scene are destroyed
+    scene.clear();
+
+    // Create here specific forms and add them to the list...
+    // They are built in the pools of the scene, which counts them
+    Cube_face *pFace = NULL;
+//    pFace = new Cube_face(Vector(1,0,0), Vector(0,1,0), Point(-0.5, -0.5, -0.5), 1, 1, ORANGE);
+//    forms_list[number_of_forms] = pFace;
+//    number_of_forms++;
+//
+//    Cube_face *pFace2 = NULL;
+//    pFace2 = new Cube_face(Vector(0,1,0), Vector(0,0,1), Point(-0.5, -0.5, -0.5), 1, 1, BLUE);
+//    forms_list[number_of_forms] = pFace2;
+//    number_of_forms++;
+//
+//    Cube_face *pFace3 = NULL;
+//    pFace3 = new Cube_face(Vector(1,0,0), Vector(0,0,1), Point(-0.5, -0.5, -0.5), 1, 1, RED);
+//    forms_list[number_of_forms] = pFace3;
+//    number_of_forms++;
+//
+//    Cube_face *pFace4 = NULL;
+//    pFace4 = new Cube_face(Vector(0,-1,0), Vector(0,0,-1), Point(0.5, 0.5, 0.5), 1, 1, GREEN);
+//    forms_list[number_of_forms] = pFace4;
+//    number_of_forms++;
+//
+//    Cube_face *pFace5 = NULL;
+//    pFace5 = new Cube_face(Vector(-1,0,0), Vector(0,0,-1), Point(0.5, 0.5, 0.5), 1, 1, WHITE);
+//    forms_list[number_of_forms] = pFace5;
+//    number_of_forms++;
+//
+//    Cube_face *pFace6 = NULL;
+//    pFace6 = new Cube_face(Vector(-1,0,0), Vector(0,-1,0), Point(0.5, 0.5, 0.5), 1, 1, YELLOW);
+//    forms_list[number_of_forms] = pFace6;
+//    number_of_forms++;
+
+    // Cube_face *pFace = NULL;
+    // pFace = new Cube_face(Vector(1,0,0), Vector(0,1,0), Point(0.5, 0, 0.5), 1, 1, ORANGE);
+    // forms_list[number_of_forms] = pFace;
+    // number_of_forms++;
+
+//    Sphere *pSphere1 = NULL;
+//    pSphere1 = new Sphere(1, BLUE);
+//    forms_list[number_of_forms] = pSphere1;
+//    number_of_forms++;
+
+    double agr = 1;
+    // arrière
+    pFace = scene.add<Cube_face>(Vector(1,0,0), Vector(0,1,0), Point(-0.5*agr, -0.5*agr, -0.5*agr), 1*agr, 1.2*agr, WHITE);
+     //coté gauche
+    pFace = scene.add<Cube_face>(Vector(0,0,1), Vector(0,1,0), Point(-0.5*agr, -0.5*agr, -0.5*agr), 1*agr, 1.2*agr, WHITE);
+    // sol
+    pFace = scene.add<Cube_face>(Vector(1,0,0), Vector(0,0,1), Point(-0.5*agr, -0.5*agr, -0.5*agr), 1*agr, 1*agr, BLACK);
+    // coté droit
+    pFace = scene.add<Cube_face>(Vector(0,0,1), Vector(0,1,0), Point(0.5*agr, -0.5*agr, -0.5*agr), 1*agr, 1.2*agr, WHITE);
+
+     // Création de deux sphères
+    Sphere* sphere1 = scene.add<Sphere>(0.2, ORANGE); // Réduction de moitié du rayon
+    // Dropped over the middle of the tank, from the height of the original scene
+    sphere1->getAnim().setPos(Point(0, 6, 0));
+    sphere1->setIntegrator(integrator);
+    //sphere1->getAnim().setPos(Point(0.5, 0.5, 0.5));
+
+
+     // AVANT POUR L'eau
+    pFace = scene.add<Cube_face>(Vector(1,0,0), Vector(0,1,0), Point(-0.5*agr, -0.5*agr, 0.5*agr), 1*agr, 1*agr, WATER_TRANSPARENT);
+
+    if (water == WATER_PARTICLES)
+    {
+        // Tank filled up to the water level, the sphere falls in
+        SphFluid *fluid = new SphFluid(Point(-0.5*agr, -0.5*agr, -0.5*agr), Point(0.5*agr, 0.7*agr, 0.5*agr), FLUID_SPACING*agr);
+        fluid->fill(Point(-0.5*agr, -0.5*agr, -0.5*agr), Point(0.5*agr, WATER_LEVEL*agr, 0.5*agr));
+        sphere1->setFluid(fluid, fluid->addBody(sphere1->getAnim().getPos(), sphere1->getAnim().getSpeed(), sphere1->getRadius()));
+        scene.add<Fluid>(fluid, DARK_BLUE_TRANSPARENT);
+    }
+    else
+    {
+        // coté HAUT pour l'eau
+        pFace = scene.add<Cube_face>(Vector(1,0,0), Vector(0,0,1), Point(-0.5*agr, 0.5*agr, -0.5*agr), 1*agr, 1*agr,DARK_BLUE_TRANSPARENT);
+        pFace->setSolid(false); // The spheres fall through the water
+
+        // Water surface over the tank, at the level of the top face
+        // Cubic B-spline following the waves simulated in the tank
+        int nbPtsCtrlX = 17;
+        int nbPtsCtrlZ = 17;
+
+        GLfloat *ctrlPoints = new GLfloat[nbPtsCtrlX*nbPtsCtrlZ*3];
+
+        for (int i = 0; i < nbPtsCtrlZ; i++) {
+            for (int j = 0; j < nbPtsCtrlX; j++) {
+                ctrlPoints[(i*nbPtsCtrlX*3)+j*3+0] = (-0.5 + j / (nbPtsCtrlX - 1.0)) * agr;
+                ctrlPoints[(i*nbPtsCtrlX*3)+j*3+1] = 0.5 * agr;
+                ctrlPoints[(i*nbPtsCtrlX*3)+j*3+2] = (-0.5 + i / (nbPtsCtrlZ - 1.0)) * agr;
+            }
+        }
+
+        Surface *pSurface = NULL;
+        pSurface = scene.add<Surface>(ctrlPoints, nbPtsCtrlX, nbPtsCtrlZ, DARK_BLUE_TRANSPARENT, 4);
+        pSurface->setWaves(new WaveField(WAVE_CELLS, WAVE_CELLS, -0.5*agr, -0.5*agr, agr / WAVE_CELLS, 0.5*agr, 1*agr));
+        delete[] ctrlPoints; // Copied by the surface
+
+        // The sphere floats on the waves
+        sphere1->setWaves(pSurface->getWaves());
+    }
+
+    // The sphere stays in the tank
+    scene.getCollisions().setBroadPhase(broad_phase);
+    scene.getCollisions().clearWalls();
+    add_walls(scene.getCollisions(), scene);
+
+    // Initial state, nothing to interpolate yet
+    store_states(scene);
+    interpolate(scene, 1.0);
+
+    return scene.size();
+}
+
+
+void create_bodies(BodyStore& bodies, int number_of_bodies)
+{
+    bodies.clear();
+    bodies.reserve(number_of_bodies);
+
+    // Square grid over the water of the tank (1 x 1), as few layers as possible
+    // so that the bodies float rather than fall : cells of at least 1 cm
+    int side = (int)ceil(sqrt((double)number_of_bodies));
+    if (side > 100)
+    {
+        side = 100;
+    }
+    double cell = 1.0 / side;
+    for (int i = 0; i < number_of_bodies; i++)
+    {
+        int layer = i / (side * side);
+        int row = (i / side) % side;
+        int col = i % side;
+        // Radius between 20% and 40% of the cell size
+        double r = cell * (0.2 + 0.2 * ((i * 7) % 11) / 10.0);
+        Point pos(-0.5 + (col + 0.5) * cell, WATER_LEVEL + (layer + 0.5) * cell, -0.5 + (row + 0.5) * cell);
+        bodies.add(pos, Vector(0, 0, 0), r, SPHERE_DENSITY);
+    }
+}
+
+
+void add_walls(CollisionSystem& collisions, Scene& scene)
+{
+    std::vector<Cube_face*> faces;
+    for (size_t i = 0; i < scene.getFaces().size(); i++)
+    {
+        if (scene.getFaces()[i]->isSolid())
+        {
+            faces.push_back(scene.getFaces()[i]);
+        }
+    }
+    int number_of_faces = (int)faces.size();
+
+    // Mean of the face centers, inside a convex container
+    Vector inside;
+    for (int k = 0; k < number_of_faces; k++)
+    {
+        Cube_face* face = faces[k];
+        Vector center = Vector(Point(), face->getAnim().getPos()) + 0.5 * face->getLength() * face->getVdir1()
+                        + 0.5 * face->getWidth() * face->getVdir2();
+        inside += 1.0 / number_of_faces * center;
+    }
+
+    for (int k = 0; k < number_of_faces; k++)
+    {
+        Cube_face* face = faces[k];
+        collisions.addWall(Wall(face->getAnim().getPos(), face->getVdir1(), face->getVdir2(),
+                                face->getLength(), face->getWidth(), Point() + inside));
+    }
+}
+
+
+// Spheres pushed out of each other and of the tank after they moved
+static void collide_spheres(Scene& scene, ThreadPool* pool)
+{
+    // Same arrays as the batched spheres, in the order of the spheres
+    const std::vector<Sphere*>& spheres = scene.getSpheres();
+    BodyStore& bodies = scene.getBodies();
+    bodies.clear();
+    for (size_t k = 0; k < spheres.size(); k++)
+    {
+        Sphere* sphere = spheres[k];
+        bodies.add(sphere->getAnim().getPos(), sphere->getAnim().getSpeed(), sphere->getRadius(), sphere->getDensity(),
+                   sphere->getAnim().getAngularSpeed());
+    }
+
+    BodyArrays arrays = bodies.getArrays();
+    if (pool != NULL)
+    {
+        scene.getCollisions().step(arrays, *pool);
+    }
+    else
+    {
+        scene.getCollisions().step(arrays);
+    }
+
+    for (size_t k = 0; k < spheres.size(); k++)
+    {
+        spheres[k]->getAnim().setPos(bodies.getPos(k));
+        spheres[k]->getAnim().setSpeed(bodies.getSpeed(k));
+        spheres[k]->getAnim().setAngularSpeed(bodies.getAngularSpeed(k));
+    }
+}
+
+
+// Advances the waves of the water surfaces, before the forms floating on them
+static void step_waves(Scene& scene, double delta_t, ThreadPool* pool)
+{
+    const std::vector<Surface*>& surfaces = scene.getSurfaces();
+    for (size_t i = 0; i < surfaces.size(); i++)
+    {
+        if (surfaces[i]->getWaves() != NULL)
+        {
+            if (pool != NULL)
+            {
+                surfaces[i]->getWaves()->step(delta_t, *pool);
+            }
+            else
+            {
+                surfaces[i]->getWaves()->step(delta_t);
+            }
+        }
+    }
+}
+
+
+// Advances the fluid particles with the spheres in them where they are now,
+// the spheres then move with the force of the particles
+static void step_fluids(Scene& scene, double delta_t, ThreadPool* pool)
+{
+    const std::vector<Sphere*>& spheres = scene.getSpheres();
+    for (size_t i = 0; i < spheres.size(); i++)
+    {
+        Sphere* sphere = spheres[i];
+        if (sphere->getFluid() != NULL)
+        {
+            sphere->getFluid()->setBody(sphere->getFluidBody(), sphere->getAnim().getPos(), sphere->getAnim().getSpeed());
+        }
+    }
+
+    const std::vector<Fluid*>& fluids = scene.getFluids();
+    for (size_t i = 0; i < fluids.size(); i++)
+    {
+        if (pool != NULL)
+        {
+            fluids[i]->getFluid().step(delta_t, *pool);
+        }
+        else
+        {
+            fluids[i]->getFluid().step(delta_t);
+        }
+    }
+}
+
+
+// Forms [begin, end[ of a group, the update of the class is called directly
+template <class T>
+static void update_forms(const std::vector<T*>& forms, int begin, int end, double delta_t)
+{
+    for (int i = begin; i < end; i++)
+    {
+        forms[i]->getAnim().storeState();
+        forms[i]->update(delta_t);
+    }
+}
+
+
+template <class T>
+static void update_group(const std::vector<T*>& forms, double delta_t, ThreadPool* pool)
+{
+    if (pool != NULL)
+    {
+        pool->parallelFor((int)forms.size(), FORM_GRAIN, [&forms, delta_t](int begin, int end)
+        {
+            update_forms(forms, begin, end, delta_t);
+        });
+    }
+    else
+    {
+        update_forms(forms, 0, (int)forms.size(), delta_t);
+    }
+}
+
+
+// Calls fn on the forms of each group
+template <class F>
+static void for_each_group(Scene& scene, F fn)
+{
+    fn(scene.getSpheres());
+    fn(scene.getFaces());
+    fn(scene.getSurfaces());
+    fn(scene.getFluids());
+}
+
+
+void update(Scene& scene, double delta_t)
+{
+    step_waves(scene, delta_t, NULL);
+    step_fluids(scene, delta_t, NULL);
+
+    // Update the list of forms, group by group
+    for_each_group(scene, [delta_t](const auto& forms) {update_group(forms, delta_t, NULL);});
+
+    collide_spheres(scene, NULL);
+}
+
+
+void update(Scene& scene, double delta_t, ThreadPool& pool)
+{
+    step_waves(scene, delta_t, &pool);
+    step_fluids(scene, delta_t, &pool);
+
+    for_each_group(scene, [delta_t, &pool](const auto& forms) {update_group(forms, delta_t, &pool);});
+
+    collide_spheres(scene, &pool);
+}
+
+
+void store_states(Scene& scene)
+{
+    for_each_group(scene, [](const auto& forms)
+    {
+        for (size_t i = 0; i < forms.size(); i++)
+        {
+            forms[i]->getAnim().storeState();
+        }
+    });
+}
+
+
+void interpolate(Scene& scene, double alpha)
+{
+    for_each_group(scene, [alpha](const auto& forms)
+    {
+        for (size_t i = 0; i < forms.size(); i++)
+        {
+            forms[i]->getAnim().interpolate(alpha);
+        }
+    });
+}
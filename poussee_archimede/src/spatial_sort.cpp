@@ -0,0 +1,115 @@
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include "spatial_sort.h"
+
+
+// Bits of a coordinate moved two zeros apart : abc -> a00b00c
+static unsigned int spread_bits(unsigned int v)
+{
+    v &= (1u << MORTON_BITS) - 1;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+
+unsigned int morton_code(unsigned int x, unsigned int y, unsigned int z)
+{
+    return spread_bits(x) | (spread_bits(y) << 1) | (spread_bits(z) << 2);
+}
+
+
+SpatialSort::SpatialSort(SpatialOrder o, int n)
+{
+    curve = o;
+    cellSize = 1.0;
+    countX = countY = countZ = 1;
+    interval = n;
+    calls = 0;
+    cellRank.assign(1, 0);
+    cellStart.assign(2, 0);
+}
+
+
+void SpatialSort::setGrid(Point low, Point high, double size)
+{
+    this->low = low;
+    cellSize = size;
+    int limit = 1 << MORTON_BITS;
+    for (;;)
+    {
+        countX = std::max(1, (int)ceil((high.x - low.x) / cellSize));
+        countY = std::max(1, (int)ceil((high.y - low.y) / cellSize));
+        countZ = std::max(1, (int)ceil((high.z - low.z) / cellSize));
+        if (countX <= limit && countY <= limit && countZ <= limit)
+        {
+            break;
+        }
+        cellSize *= 2.0;
+    }
+
+    // Cells sorted once by code, their rank replaces the code in the sorts
+    int cells = countX * countY * countZ;
+    // Key and index of each cell : the keys of the rows order take up to 40 bits
+    std::vector<std::pair<unsigned long long, int> > keys(cells);
+    for (int z = 0; z < countZ; z++)
+    {
+        for (int y = 0; y < countY; y++)
+        {
+            for (int x = 0; x < countX; x++)
+            {
+                unsigned long long key;
+                if (curve == ORDER_MORTON_ROWS)
+                {
+                    key = ((unsigned long long)morton_code(0, y, z) << MORTON_BITS) | x;
+                }
+                else
+                {
+                    key = morton_code(x, y, z);
+                }
+                int c = cellIndex(x, y, z);
+                keys[c] = std::make_pair(key, c);
+            }
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    cellRank.resize(cells);
+    for (int r = 0; r < cells; r++)
+    {
+        cellRank[keys[r].second] = r;
+    }
+    cellStart.assign(cells + 1, 0);
+}
+
+
+int SpatialSort::cellCoordinate(double p, double org, int count) const
+{
+    return std::min(std::max((int)floor((p - org) / cellSize), 0), count - 1);
+}
+
+
+void SpatialSort::sort(const double *x, const double *y, const double *z, int count)
+{
+    std::fill(cellStart.begin(), cellStart.end(), 0);
+    pointCell.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        pointCell[i] = cellRank[cellIndex(getCellX(x[i]), getCellY(y[i]), getCellZ(z[i]))];
+        cellStart[pointCell[i] + 1]++;
+    }
+    for (size_t c = 1; c < cellStart.size(); c++)
+    {
+        cellStart[c] += cellStart[c - 1];
+    }
+    next.assign(cellStart.begin(), cellStart.end() - 1);
+    order.resize(count);
+    rank.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        rank[i] = next[pointCell[i]]++;
+        order[rank[i]] = i;
+    }
+}
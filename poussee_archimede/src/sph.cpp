@@ -0,0 +1,575 @@
+#include <cmath>
+#include <algorithm>
+#include "sph.h"
+#include "physics.h"
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+SphFluid::SphFluid(Point low, Point high, double spacing, double density)
+{
+    this->low = low;
+    this->high = high;
+    this->spacing = spacing;
+    support = SPH_SUPPORT * spacing;
+    restDensity = density;
+    substeps = 0;
+    grid = SpatialSort(ORDER_MORTON_ROWS);
+    grid.setGrid(low, high, support / SPH_CELL_SPLIT);
+
+    // Density kernel summed over a lattice particle and its neighbours
+    double h2 = support * support;
+    double poly6 = 315.0 / (64.0 * M_PI * pow(support, 9));
+    int reach = (int)SPH_SUPPORT;
+    double sum = 0.0;
+    for (int i = -reach; i <= reach; i++)
+    {
+        for (int j = -reach; j <= reach; j++)
+        {
+            for (int k = -reach; k <= reach; k++)
+            {
+                double r2 = (i * i + j * j + k * k) * spacing * spacing;
+                if (r2 < h2)
+                {
+                    sum += poly6 * pow(h2 - r2, 3);
+                }
+            }
+        }
+    }
+    mass = restDensity / sum;
+    buildWallTables();
+}
+
+
+void SphFluid::buildWallTables()
+{
+    double h = support;
+    double h2 = h * h;
+    double poly6 = mass * 315.0 / (64.0 * M_PI * pow(h, 9));
+    double spiky = mass * 45.0 / (M_PI * pow(h, 6));
+    int reach = (int)SPH_SUPPORT;
+
+    for (int t = 0; t <= SPH_WALL_SAMPLES; t++)
+    {
+        // Layers of ghosts behind the wall, the first one half a spacing behind
+        // as the particles filling a box start half a spacing in front
+        double d = t * h / SPH_WALL_SAMPLES;
+        double rho = 0.0, push = 0.0;
+        for (double depth = d + 0.5 * spacing; depth < h; depth += spacing)
+        {
+            for (int i = -reach; i <= reach; i++)
+            {
+                for (int j = -reach; j <= reach; j++)
+                {
+                    double r2 = (i * i + j * j) * spacing * spacing + depth * depth;
+                    if (r2 < h2)
+                    {
+                        double r = sqrt(r2);
+                        rho += poly6 * pow(h2 - r2, 3);
+                        // Along the normal only, the sideways pushes cancel out
+                        push += spiky * (h - r) * (h - r) * depth / r;
+                    }
+                }
+            }
+        }
+        wallDensity[t] = rho;
+        wallPush[t] = push;
+    }
+
+    // Ghosts behind two perpendicular sides, the edge along z
+    int samples = SPH_WALL_SAMPLES + 1;
+    edgeDensity.assign(samples * samples, 0.0);
+    edgePush.assign(samples * samples, 0.0);
+    for (int t = 0; t < samples; t++)
+    {
+        for (int u = 0; u < samples; u++)
+        {
+            double d1 = t * h / SPH_WALL_SAMPLES, d2 = u * h / SPH_WALL_SAMPLES;
+            double rho = 0.0, push = 0.0;
+            for (double depth1 = d1 + 0.5 * spacing; depth1 < h; depth1 += spacing)
+            {
+                for (double depth2 = d2 + 0.5 * spacing; depth2 < h; depth2 += spacing)
+                {
+                    for (int i = -reach; i <= reach; i++)
+                    {
+                        double r2 = i * i * spacing * spacing + depth1 * depth1 + depth2 * depth2;
+                        if (r2 < h2)
+                        {
+                            double r = sqrt(r2);
+                            rho += poly6 * pow(h2 - r2, 3);
+                            push += spiky * (h - r) * (h - r) * depth1 / r;
+                        }
+                    }
+                }
+            }
+            edgeDensity[t * samples + u] = rho;
+            edgePush[t * samples + u] = push;
+        }
+    }
+}
+
+
+// Linear interpolation in a wall table
+static double wall_table(const double table[SPH_WALL_SAMPLES + 1], double distance, double support)
+{
+    double f = std::max(distance, 0.0) / support * SPH_WALL_SAMPLES;
+    if (f >= SPH_WALL_SAMPLES)
+    {
+        return 0.0;
+    }
+    int i = (int)f;
+    double t = f - i;
+    return (1.0 - t) * table[i] + t * table[i + 1];
+}
+
+
+double SphFluid::getWallDensity(double distance) const
+{
+    return wall_table(wallDensity, distance, support);
+}
+
+
+double SphFluid::getWallPush(double distance) const
+{
+    return wall_table(wallPush, distance, support);
+}
+
+
+// Bilinear interpolation in an edge table, 0 if a distance is beyond the kernel radius
+static double edge_table(const std::vector<double>& table, double d1, double d2, double support)
+{
+    double f1 = std::max(d1, 0.0) / support * SPH_WALL_SAMPLES;
+    double f2 = std::max(d2, 0.0) / support * SPH_WALL_SAMPLES;
+    if (f1 >= SPH_WALL_SAMPLES || f2 >= SPH_WALL_SAMPLES)
+    {
+        return 0.0;
+    }
+    int i = (int)f1, j = (int)f2;
+    double t = f1 - i, u = f2 - j;
+    int samples = SPH_WALL_SAMPLES + 1;
+    const double *row = table.data() + i * samples + j;
+    return (1.0 - t) * ((1.0 - u) * row[0] + u * row[1]) + t * ((1.0 - u) * row[samples] + u * row[samples + 1]);
+}
+
+
+// Distances to the sides of the box : -x, +x, -y, +y, -z, +z
+static void box_distances(double x, double y, double z, const Point& low, const Point& high, double side[6])
+{
+    side[0] = x - low.x;
+    side[1] = high.x - x;
+    side[2] = y - low.y;
+    side[3] = high.y - y;
+    side[4] = z - low.z;
+    side[5] = high.z - z;
+}
+
+
+// True if a point is farther than the kernel radius from all the sides : no ghost
+static bool inner_point(const double side[6], double support)
+{
+    return *std::min_element(side, side + 6) >= support;
+}
+
+
+double SphFluid::getBoxDensity(double x, double y, double z) const
+{
+    double side[6];
+    box_distances(x, y, z, low, high, side);
+    if (inner_point(side, support))
+    {
+        return 0.0;
+    }
+    double rho = 0.0;
+    for (int w = 0; w < 6; w++)
+    {
+        rho += getWallDensity(side[w]);
+    }
+    // Sides of two different axes
+    for (int w = 0; w < 4; w++)
+    {
+        for (int v = (w / 2 + 1) * 2; v < 6; v++)
+        {
+            rho -= edge_table(edgeDensity, side[w], side[v], support);
+        }
+    }
+    return rho;
+}
+
+
+Vector SphFluid::getBoxPush(double x, double y, double z) const
+{
+    double side[6];
+    box_distances(x, y, z, low, high, side);
+    if (inner_point(side, support))
+    {
+        return Vector();
+    }
+    // Along the inner normal of each side
+    double push[6];
+    for (int w = 0; w < 6; w++)
+    {
+        push[w] = getWallPush(side[w]);
+    }
+    for (int w = 0; w < 4; w++)
+    {
+        for (int v = (w / 2 + 1) * 2; v < 6; v++)
+        {
+            push[w] -= edge_table(edgePush, side[w], side[v], support);
+            push[v] -= edge_table(edgePush, side[v], side[w], support);
+        }
+    }
+    return Vector(push[0] - push[1], push[2] - push[3], push[4] - push[5]);
+}
+
+
+void SphFluid::fill(Point from, Point to)
+{
+    for (double z = from.z + 0.5 * spacing; z < to.z; z += spacing)
+    {
+        for (double y = from.y + 0.5 * spacing; y < to.y; y += spacing)
+        {
+            for (double x = from.x + 0.5 * spacing; x < to.x; x += spacing)
+            {
+                px.push_back(x);
+                py.push_back(y);
+                pz.push_back(z);
+                vx.push_back(0.0);
+                vy.push_back(0.0);
+                vz.push_back(0.0);
+            }
+        }
+    }
+    int n = size();
+    density.assign(n, restDensity);
+    pressure.assign(n, 0.0);
+    ax.assign(n, 0.0);
+    ay.assign(n, 0.0);
+    az.assign(n, 0.0);
+    swapBuffer.resize(n);
+}
+
+
+int SphFluid::addBody(Point pos, Vector spd, double radius)
+{
+    SphBody body;
+    body.pos = pos;
+    body.spd = spd;
+    body.radius = radius;
+    body.active = true;
+    // In the place of a removed body first
+    for (size_t b = 0; b < bodies.size(); b++)
+    {
+        if (!bodies[b].active)
+        {
+            bodies[b] = body;
+            return (int)b;
+        }
+    }
+    bodies.push_back(body);
+    return (int)bodies.size() - 1;
+}
+
+
+void SphFluid::removeBody(int k)
+{
+    bodies[k].active = false;
+    bodies[k].force = Vector();
+}
+
+
+void SphFluid::setBody(int k, Point pos, Vector spd)
+{
+    bodies[k].pos = pos;
+    bodies[k].spd = spd;
+}
+
+
+void SphFluid::sortParticles()
+{
+    // Particles close in space close in memory, the particles of a cell stay in their previous order
+    grid.sort(px.data(), py.data(), pz.data(), size());
+    std::vector<double>* fields[6] = {&px, &py, &pz, &vx, &vy, &vz};
+    for (int f = 0; f < 6; f++)
+    {
+        grid.apply(*fields[f], swapBuffer);
+    }
+}
+
+
+void SphFluid::computeDensity(double time, int begin, int end, std::vector<int>& list)
+{
+    double h2 = support * support;
+    double poly6 = mass * 315.0 / (64.0 * M_PI * pow(support, 9));
+    double stiffness = SPH_SOUND_SPEED * SPH_SOUND_SPEED;
+
+    list.clear();
+    for (int i = begin; i < end; i++)
+    {
+        double x = px[i], y = py[i], z = pz[i];
+        int cx = grid.getCellX(x), cy = grid.getCellY(y), cz = grid.getCellZ(z);
+        int firstX = std::max(cx - SPH_CELL_SPLIT, 0), lastX = std::min(cx + SPH_CELL_SPLIT, grid.getCountX() - 1);
+        int firstY = std::max(cy - SPH_CELL_SPLIT, 0), lastY = std::min(cy + SPH_CELL_SPLIT, grid.getCountY() - 1);
+        int firstZ = std::max(cz - SPH_CELL_SPLIT, 0), lastZ = std::min(cz + SPH_CELL_SPLIT, grid.getCountZ() - 1);
+        double sum = h2 * h2 * h2; // Itself
+        neighbourStart[i] = (int)list.size();
+        for (int k = firstZ; k <= lastZ; k++)
+        {
+            for (int j = firstY; j <= lastY; j++)
+            {
+                // The cells of a row along x are contiguous
+                int first, last;
+                grid.getRowRange(firstX, lastX, j, k, first, last);
+                for (int l = first; l < last; l++)
+                {
+                    double dx = x - px[l], dy = y - py[l], dz = z - pz[l];
+                    double r2 = dx * dx + dy * dy + dz * dz;
+                    if (r2 < h2 && l != i)
+                    {
+                        double w = h2 - r2;
+                        sum += w * w * w;
+                        list.push_back(l);
+                    }
+                }
+            }
+        }
+        neighbourCount[i] = (int)list.size() - neighbourStart[i];
+
+        double rho = poly6 * sum;
+        // Ghosts of the sides of the box and of the bodies
+        rho += getBoxDensity(x, y, z);
+        for (size_t b = 0; b < bodies.size(); b++)
+        {
+            if (!bodies[b].active)
+            {
+                continue;
+            }
+            Point center = bodies[b].pos + time * bodies[b].spd;
+            double distance = sqrt(Vector(center, Point(x, y, z)) * Vector(center, Point(x, y, z))) - bodies[b].radius;
+            rho += getWallDensity(distance);
+        }
+        density[i] = rho;
+        // No tension : a particle with missing neighbours (surface) isn't pulled back
+        pressure[i] = std::max(stiffness * (rho - restDensity), 0.0);
+    }
+}
+
+
+void SphFluid::computeForces(double dt, double time, int begin, int end, const std::vector<int>& list, Vector *bodyImpulses)
+{
+    double h = support;
+    // Gradient of the spiky kernel and laplacian of the viscosity kernel share their constant
+    double k = mass * 45.0 / (M_PI * pow(h, 6));
+    double viscosity = getViscosity();
+
+    for (int i = begin; i < end; i++)
+    {
+        double x = px[i], y = py[i], z = pz[i];
+        double pi = pressure[i] / (density[i] * density[i]);
+        double fx = 0.0, fy = 0.0, fz = 0.0;
+        const int *neighbour = list.data() + neighbourStart[i];
+        for (int n = 0; n < neighbourCount[i]; n++)
+        {
+            int l = neighbour[n];
+            double dx = x - px[l], dy = y - py[l], dz = z - pz[l];
+            double r = sqrt(dx * dx + dy * dy + dz * dz);
+            if (r == 0.0)
+            {
+                continue;
+            }
+            double w = h - r;
+            // Symmetric pressure term, pushes the particles apart along the line between them
+            double push = (pi + pressure[l] / (density[l] * density[l])) * w * w / r;
+            // Speeds brought closer to the ones of the neighbours
+            double drag = viscosity / (density[i] * density[l]) * w;
+            fx += push * dx + drag * (vx[l] - vx[i]);
+            fy += push * dy + drag * (vy[l] - vy[i]);
+            fz += push * dz + drag * (vz[l] - vz[i]);
+        }
+        ax[i] = k * fx;
+        ay[i] = k * fy - GRAVITY;
+        az[i] = k * fz;
+
+        // Ghosts at the pressure of the particle : pushed back from the sides of the box
+        double ghost = 2.0 * pi;
+        Vector box = getBoxPush(x, y, z);
+        ax[i] += ghost * box.x;
+        ay[i] += ghost * box.y;
+        az[i] += ghost * box.z;
+        // and from the bodies, which take the opposite force
+        for (size_t b = 0; b < bodies.size(); b++)
+        {
+            if (!bodies[b].active)
+            {
+                continue;
+            }
+            Point center = bodies[b].pos + time * bodies[b].spd;
+            Vector d(center, Point(x, y, z));
+            double distance = sqrt(d * d);
+            double push = ghost * getWallPush(distance - bodies[b].radius);
+            if (push > 0.0 && distance > 0.0)
+            {
+                Vector acc = push / distance * d;
+                ax[i] += acc.x;
+                ay[i] += acc.y;
+                az[i] += acc.z;
+                bodyImpulses[b] += -(dt * mass) * acc;
+            }
+        }
+    }
+}
+
+
+// Particle out of a side of the box : put back on the side, bouncing
+static void bounce(double& p, double& v, double side, bool below)
+{
+    if (below ? p < side : p > side)
+    {
+        p = side;
+        if (below ? v < 0.0 : v > 0.0)
+        {
+            v = -SPH_WALL_RESTITUTION * v;
+        }
+    }
+}
+
+
+void SphFluid::moveParticles(double dt, double time, int begin, int end, Vector *bodyImpulses)
+{
+    for (int i = begin; i < end; i++)
+    {
+        // Semi-implicit Euler
+        vx[i] += dt * ax[i];
+        vy[i] += dt * ay[i];
+        vz[i] += dt * az[i];
+        px[i] += dt * vx[i];
+        py[i] += dt * vy[i];
+        pz[i] += dt * vz[i];
+
+        // Out of the bodies, the normal speed given to the particle is taken from the body
+        for (size_t b = 0; b < bodies.size(); b++)
+        {
+            const SphBody& body = bodies[b];
+            if (!body.active)
+            {
+                continue;
+            }
+            Point center = body.pos + time * body.spd;
+            Vector d(px[i] - center.x, py[i] - center.y, pz[i] - center.z);
+            double reach = body.radius + 0.5 * spacing;
+            double distance2 = d * d;
+            if (distance2 >= reach * reach)
+            {
+                continue;
+            }
+            double distance = sqrt(distance2);
+            Vector n = distance > 0.0 ? 1.0 / distance * d : Vector(0, 1, 0);
+            px[i] = center.x + reach * n.x;
+            py[i] = center.y + reach * n.y;
+            pz[i] = center.z + reach * n.z;
+            double vn = (Vector(vx[i], vy[i], vz[i]) - body.spd) * n;
+            if (vn < 0.0)
+            {
+                vx[i] -= vn * n.x;
+                vy[i] -= vn * n.y;
+                vz[i] -= vn * n.z;
+                bodyImpulses[b] += (mass * vn) * n;
+            }
+        }
+
+        bounce(px[i], vx[i], low.x, true);
+        bounce(px[i], vx[i], high.x, false);
+        bounce(py[i], vy[i], low.y, true);
+        bounce(py[i], vy[i], high.y, false);
+        bounce(pz[i], vz[i], low.z, true);
+        bounce(pz[i], vz[i], high.z, false);
+    }
+}
+
+
+double SphFluid::getViscosity() const
+{
+    return SPH_VISCOSITY * restDensity * SPH_SOUND_SPEED * support / 8.0;
+}
+
+
+int SphFluid::getSubsteps(double delta_t) const
+{
+    // Sound waves crossing part of a kernel, and explicit viscosity
+    double sound = SPH_COURANT * support / SPH_SOUND_SPEED;
+    double viscous = 0.125 * support * support * restDensity / getViscosity();
+    return std::max(1, (int)ceil(delta_t / std::min(sound, viscous)));
+}
+
+
+void SphFluid::finishStep(double delta_t, int chunks)
+{
+    // Chunks summed in a fixed order
+    for (size_t b = 0; b < bodies.size(); b++)
+    {
+        Vector impulse;
+        for (int c = 0; c < chunks; c++)
+        {
+            impulse += impulses[c * bodies.size() + b];
+        }
+        bodies[b].force = 1.0 / delta_t * impulse;
+    }
+}
+
+
+void SphFluid::step(double delta_t)
+{
+    int n = size();
+    int count = getSubsteps(delta_t);
+    double dt = delta_t / count;
+    impulses.assign(bodies.size(), Vector());
+    neighbours.resize(1);
+    neighbourStart.resize(n);
+    neighbourCount.resize(n);
+
+    for (int s = 0; s < count; s++)
+    {
+        sortParticles();
+        computeDensity(s * dt, 0, n, neighbours[0]);
+        computeForces(dt, s * dt, 0, n, neighbours[0], impulses.data());
+        moveParticles(dt, s * dt, 0, n, impulses.data());
+    }
+    substeps += count;
+    finishStep(delta_t, 1);
+}
+
+
+void SphFluid::step(double delta_t, ThreadPool& pool)
+{
+    int n = size();
+    int count = getSubsteps(delta_t);
+    double dt = delta_t / count;
+    int chunk = pool.chunkSize(n, SPH_GRAIN);
+    int chunks = n > 0 ? (n + chunk - 1) / chunk : 0;
+    impulses.assign(chunks * bodies.size(), Vector());
+    neighbours.resize(chunks);
+    neighbourStart.resize(n);
+    neighbourCount.resize(n);
+
+    for (int s = 0; s < count; s++)
+    {
+        sortParticles();
+        double time = s * dt;
+        // All the densities are needed by the forces, all the forces before any particle moves
+        pool.parallelFor(n, SPH_GRAIN, [this, time, chunk](int begin, int end)
+        {
+            computeDensity(time, begin, end, neighbours[begin / chunk]);
+        });
+        pool.parallelFor(n, SPH_GRAIN, [this, dt, time, chunk](int begin, int end)
+        {
+            computeForces(dt, time, begin, end, neighbours[begin / chunk],
+                          impulses.data() + (begin / chunk) * bodies.size());
+        });
+        pool.parallelFor(n, SPH_GRAIN, [this, dt, time, chunk](int begin, int end)
+        {
+            moveParticles(dt, time, begin, end, impulses.data() + (begin / chunk) * bodies.size());
+        });
+    }
+    substeps += count;
+    finishStep(delta_t, chunks);
+}
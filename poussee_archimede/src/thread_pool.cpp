@@ -0,0 +1,169 @@
+#include <algorithm>
+#include "thread_pool.h"
+
+
+// Set in the pool threads, and in the calling thread during a loop
+static thread_local bool insideLoop = false;
+
+
+ThreadPool::ThreadPool(int number_of_threads) : queues(number_of_threads > 0 ? number_of_threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+    job = NULL;
+    remaining = 0;
+    generation = 0;
+    stopping = false;
+    deterministic = true;
+
+    // The calling thread is the first worker
+    for (int i = 1; i < size(); i++)
+    {
+        threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+        stopping = true;
+    }
+    jobStart.notify_all();
+    for (unsigned int i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+}
+
+
+int ThreadPool::chunkSize(int count, int grain) const
+{
+    if (grain < 1)
+    {
+        grain = 1;
+    }
+    if (deterministic)
+    {
+        return grain;
+    }
+    // A few chunks per thread, enough to balance the load by stealing
+    int chunk = (count + 4 * size() - 1) / (4 * size());
+    return std::max(chunk, grain);
+}
+
+
+void ThreadPool::parallelFor(int count, int grain, const std::function<void(int, int)>& fn)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    int chunk = chunkSize(count, grain);
+    if (size() == 1 || insideLoop || chunk >= count)
+    {
+        // Nothing to share : the chunks are run in order on this thread
+        for (int begin = 0; begin < count; begin += chunk)
+        {
+            fn(begin, std::min(begin + chunk, count));
+        }
+        return;
+    }
+
+    // Contiguous chunks are dealt to the queues in blocks, for cache locality
+    int number_of_chunks = (count + chunk - 1) / chunk;
+    int per_queue = (number_of_chunks + size() - 1) / size();
+    job = &fn;
+    remaining = number_of_chunks;
+    for (int q = 0; q < size(); q++)
+    {
+        std::lock_guard<std::mutex> guard(queues[q].lock);
+        for (int c = q * per_queue; c < std::min((q + 1) * per_queue, number_of_chunks); c++)
+        {
+            queues[q].ranges.push_back(Range(c * chunk, std::min((c + 1) * chunk, count)));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+        generation++;
+    }
+    jobStart.notify_all();
+
+    // The calling thread works too
+    insideLoop = true;
+    while (runOne(0))
+    {
+    }
+    insideLoop = false;
+
+    std::unique_lock<std::mutex> lock(jobLock);
+    jobDone.wait(lock, [this] {return remaining == 0;});
+    job = NULL;
+}
+
+
+bool ThreadPool::runOne(int index)
+{
+    Range range;
+    bool found = false;
+
+    // Own chunks first, from the front to follow the memory order
+    {
+        std::lock_guard<std::mutex> guard(queues[index].lock);
+        if (!queues[index].ranges.empty())
+        {
+            range = queues[index].ranges.front();
+            queues[index].ranges.pop_front();
+            found = true;
+        }
+    }
+    // Then steal from the back of the other queues
+    for (int i = 1; !found && i < size(); i++)
+    {
+        WorkQueue& victim = queues[(index + i) % size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.ranges.empty())
+        {
+            range = victim.ranges.back();
+            victim.ranges.pop_back();
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        return false;
+    }
+
+    (*job)(range.begin, range.end);
+
+    if (--remaining == 0)
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+        jobDone.notify_all();
+    }
+    return true;
+}
+
+
+void ThreadPool::workerLoop(int index)
+{
+    insideLoop = true;
+    unsigned long seen = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(jobLock);
+            jobStart.wait(lock, [this, seen] {return stopping || generation != seen;});
+            if (stopping)
+            {
+                return;
+            }
+            seen = generation;
+        }
+        while (runOne(index))
+        {
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#include <cmath>
+#include "timestep.h"
+
+
+FixedTimeStep::FixedTimeStep(double dt, int max_substeps, double max_frame_time)
+{
+    step = dt;
+    maxSubsteps = max_substeps;
+    maxFrameTime = max_frame_time;
+    accumulator = 0.0;
+}
+
+
+int FixedTimeStep::advance(double frame_time)
+{
+    // A very long frame (breakpoint, window moved...) is not fully simulated
+    if (frame_time > maxFrameTime)
+    {
+        frame_time = maxFrameTime;
+    }
+    if (frame_time > 0.0)
+    {
+        accumulator += frame_time;
+    }
+
+    int steps = (int)(accumulator / step);
+    if (steps > maxSubsteps)
+    {
+        // The physics can't keep up : the late time is dropped
+        // instead of making the next frames even longer
+        steps = maxSubsteps;
+        accumulator = fmod(accumulator, step);
+    }
+    else
+    {
+        accumulator -= steps * step;
+        if (accumulator < 0.0)
+        {
+            accumulator = 0.0; // Rounding errors
+        }
+    }
+
+    return steps;
+}
@@ -0,0 +1,344 @@
+#include <cmath>
+#include <algorithm>
+#include "waves.h"
+#include "physics.h"
+#include "kernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_X86
+#include <immintrin.h>
+#endif
+
+
+WaveField::WaveField(int countX, int countZ, double originX, double originZ, double cellSize, double level, double depth)
+{
+    this->countX = countX;
+    this->countZ = countZ;
+    this->originX = originX;
+    this->originZ = originZ;
+    this->cellSize = cellSize;
+    stride = countX + 2;
+    restLevel = level;
+    speed = sqrt(GRAVITY * depth);
+    height.assign(stride * (countZ + 2), 0.0);
+    velocity.assign(stride * (countZ + 2), 0.0);
+}
+
+
+double WaveField::getLevel(double x, double z) const
+{
+    // Position between the centers of the cells
+    double fx = std::min(std::max((x - originX) / cellSize - 0.5, 0.0), countX - 1.0);
+    double fz = std::min(std::max((z - originZ) / cellSize - 0.5, 0.0), countZ - 1.0);
+    int i = (int)fx, j = (int)fz;
+    double tx = fx - i, tz = fz - j;
+    int i1 = std::min(i + 1, countX - 1), j1 = std::min(j + 1, countZ - 1);
+
+    double h0 = (1.0 - tx) * getHeight(i, j) + tx * getHeight(i1, j);
+    double h1 = (1.0 - tx) * getHeight(i, j1) + tx * getHeight(i1, j1);
+    return restLevel + (1.0 - tz) * h0 + tz * h1;
+}
+
+
+double WaveField::getVolume() const
+{
+    double sum = 0.0;
+    for (int j = 0; j < countZ; j++)
+    {
+        for (int i = 0; i < countX; i++)
+        {
+            sum += getHeight(i, j);
+        }
+    }
+    return sum * cellSize * cellSize;
+}
+
+
+bool WaveField::Push::operator<(const Push& p) const
+{
+    if (x != p.x) return x < p.x;
+    if (z != p.z) return z < p.z;
+    if (radius != p.radius) return radius < p.radius;
+    return volume < p.volume;
+}
+
+
+void WaveField::push(double x, double z, double radius, double volume)
+{
+    Push p;
+    p.x = x;
+    p.z = z;
+    p.radius = radius;
+    p.volume = volume;
+
+    std::lock_guard<std::mutex> lock(pushesMutex);
+    pushes.push_back(p);
+}
+
+
+void WaveField::applyPushes()
+{
+    std::lock_guard<std::mutex> lock(pushesMutex);
+    // Same order whatever the threads which pushed
+    std::sort(pushes.begin(), pushes.end());
+
+    double area = cellSize * cellSize;
+    std::vector<int> around;
+    for (size_t n = 0; n < pushes.size(); n++)
+    {
+        const Push& p = pushes[n];
+        // Body outside of the grid
+        if (p.x < originX || p.x > originX + countX * cellSize || p.z < originZ || p.z > originZ + countZ * cellSize)
+        {
+            continue;
+        }
+
+        // The whole surface rises, but part of the water is pushed aside in a ring around the body,
+        // up to twice its radius : nothing changes under the body, which would feel its own dip
+        double waves = WAVE_COUPLING * p.volume;
+        restLevel += (p.volume - waves) / (countX * countZ * area);
+        double ring = std::max(2.0 * p.radius, p.radius + cellSize);
+        int i0 = std::max((int)floor((p.x - ring - originX) / cellSize), 0);
+        int i1 = std::min((int)floor((p.x + ring - originX) / cellSize), countX - 1);
+        int j0 = std::max((int)floor((p.z - ring - originZ) / cellSize), 0);
+        int j1 = std::min((int)floor((p.z + ring - originZ) / cellSize), countZ - 1);
+        around.clear();
+        for (int j = j0; j <= j1; j++)
+        {
+            for (int i = i0; i <= i1; i++)
+            {
+                double dx = originX + (i + 0.5) * cellSize - p.x;
+                double dz = originZ + (j + 0.5) * cellSize - p.z;
+                double d = sqrt(dx * dx + dz * dz);
+                int cell = (j + 1) * stride + i + 1;
+                if (d >= p.radius && d < ring)
+                {
+                    around.push_back(cell);
+                }
+            }
+        }
+        // Ring thinner than the cells : no waves
+        if (around.empty())
+        {
+            restLevel += waves / (countX * countZ * area);
+            continue;
+        }
+
+        double up = waves / (around.size() * area);
+        for (size_t k = 0; k < around.size(); k++)
+        {
+            height[around[k]] += up;
+        }
+    }
+    pushes.clear();
+}
+
+
+void WaveField::updateGhosts()
+{
+    // Reflecting walls : no slope across the borders
+    for (int j = 1; j <= countZ; j++)
+    {
+        height[j * stride] = height[j * stride + 1];
+        height[j * stride + countX + 1] = height[j * stride + countX];
+    }
+    std::copy(height.begin() + stride, height.begin() + 2 * stride, height.begin());
+    std::copy(height.begin() + countZ * stride, height.begin() + (countZ + 1) * stride,
+              height.begin() + (countZ + 1) * stride);
+}
+
+
+int WaveField::getSubsteps(double delta_t) const
+{
+    return std::max((int)ceil(speed * delta_t / cellSize / WAVE_MAX_COURANT), 1);
+}
+
+
+void WaveField::accelerateRows(double delta_t, int begin, int end)
+{
+    double k = delta_t * speed * speed / (cellSize * cellSize);
+    double keep = std::max(1.0 - WAVE_DAMPING * delta_t, 0.0);
+
+    // Blocks of columns, each one swept over all the rows
+    for (int c = 0; c < countX; c += WAVE_BLOCK_COLUMNS)
+    {
+        int n = std::min(WAVE_BLOCK_COLUMNS, countX - c);
+        for (int j = begin; j < end; j++)
+        {
+            int first = (j + 1) * stride + 1 + c;
+            wave_accelerate(&height[first], &velocity[first], stride, n, k, keep);
+        }
+    }
+}
+
+
+void WaveField::moveRows(double delta_t, int begin, int end)
+{
+    for (int j = begin; j < end; j++)
+    {
+        int first = (j + 1) * stride + 1;
+        wave_move(&height[first], &velocity[first], countX, delta_t);
+    }
+}
+
+
+void WaveField::step(double delta_t)
+{
+    applyPushes();
+
+    int substeps = getSubsteps(delta_t);
+    double dt = delta_t / substeps;
+    for (int s = 0; s < substeps; s++)
+    {
+        updateGhosts();
+        accelerateRows(dt, 0, countZ);
+        moveRows(dt, 0, countZ);
+    }
+}
+
+
+void WaveField::step(double delta_t, ThreadPool& pool)
+{
+    applyPushes();
+
+    int substeps = getSubsteps(delta_t);
+    double dt = delta_t / substeps;
+    for (int s = 0; s < substeps; s++)
+    {
+        updateGhosts();
+        // All the velocities are computed from the heights before any of them moves
+        pool.parallelFor(countZ, WAVE_BLOCK_ROWS, [this, dt](int begin, int end)
+        {
+            accelerateRows(dt, begin, end);
+        });
+        pool.parallelFor(countZ, WAVE_BLOCK_ROWS, [this, dt](int begin, int end)
+        {
+            moveRows(dt, begin, end);
+        });
+    }
+}
+
+
+static void accelerate_scalar(const double *h, double *v, int stride, int begin, int n, double k, double keep)
+{
+    for (int i = begin; i < n; i++)
+    {
+        double laplacian = ((h[i - 1] + h[i + 1]) + (h[i - stride] + h[i + stride])) - 4.0 * h[i];
+        v[i] = keep * (v[i] + k * laplacian);
+    }
+}
+
+
+static void move_scalar(double *h, const double *v, int begin, int n, double delta_t)
+{
+    for (int i = begin; i < n; i++)
+    {
+        h[i] += delta_t * v[i];
+    }
+}
+
+
+#ifdef KERNEL_X86
+
+__attribute__((target("sse2")))
+static void accelerate_sse2(const double *h, double *v, int stride, int n, double k, double keep)
+{
+    const __m128d k2 = _mm_set1_pd(k);
+    const __m128d keep2 = _mm_set1_pd(keep);
+    const __m128d four = _mm_set1_pd(4.0);
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d sides = _mm_add_pd(_mm_loadu_pd(h + i - 1), _mm_loadu_pd(h + i + 1));
+        __m128d rows = _mm_add_pd(_mm_loadu_pd(h + i - stride), _mm_loadu_pd(h + i + stride));
+        __m128d laplacian = _mm_sub_pd(_mm_add_pd(sides, rows), _mm_mul_pd(four, _mm_loadu_pd(h + i)));
+        __m128d vi = _mm_add_pd(_mm_loadu_pd(v + i), _mm_mul_pd(k2, laplacian));
+        _mm_storeu_pd(v + i, _mm_mul_pd(keep2, vi));
+    }
+    accelerate_scalar(h, v, stride, i, n, k, keep);
+}
+
+
+__attribute__((target("sse2")))
+static void move_sse2(double *h, const double *v, int n, double delta_t)
+{
+    const __m128d dt = _mm_set1_pd(delta_t);
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        _mm_storeu_pd(h + i, _mm_add_pd(_mm_loadu_pd(h + i), _mm_mul_pd(dt, _mm_loadu_pd(v + i))));
+    }
+    move_scalar(h, v, i, n, delta_t);
+}
+
+
+__attribute__((target("avx2")))
+static void accelerate_avx2(const double *h, double *v, int stride, int n, double k, double keep)
+{
+    const __m256d k4 = _mm256_set1_pd(k);
+    const __m256d keep4 = _mm256_set1_pd(keep);
+    const __m256d four = _mm256_set1_pd(4.0);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d sides = _mm256_add_pd(_mm256_loadu_pd(h + i - 1), _mm256_loadu_pd(h + i + 1));
+        __m256d rows = _mm256_add_pd(_mm256_loadu_pd(h + i - stride), _mm256_loadu_pd(h + i + stride));
+        __m256d laplacian = _mm256_sub_pd(_mm256_add_pd(sides, rows), _mm256_mul_pd(four, _mm256_loadu_pd(h + i)));
+        __m256d vi = _mm256_add_pd(_mm256_loadu_pd(v + i), _mm256_mul_pd(k4, laplacian));
+        _mm256_storeu_pd(v + i, _mm256_mul_pd(keep4, vi));
+    }
+    accelerate_scalar(h, v, stride, i, n, k, keep);
+}
+
+
+__attribute__((target("avx2")))
+static void move_avx2(double *h, const double *v, int n, double delta_t)
+{
+    const __m256d dt = _mm256_set1_pd(delta_t);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm256_storeu_pd(h + i, _mm256_add_pd(_mm256_loadu_pd(h + i), _mm256_mul_pd(dt, _mm256_loadu_pd(v + i))));
+    }
+    move_scalar(h, v, i, n, delta_t);
+}
+
+#endif
+
+
+void wave_accelerate(const double *h, double *v, int stride, int n, double k, double keep)
+{
+#ifdef KERNEL_X86
+    switch(get_kernel_level())
+    {
+    case KERNEL_AVX2:
+        accelerate_avx2(h, v, stride, n, k, keep);
+        return;
+    case KERNEL_SSE2:
+        accelerate_sse2(h, v, stride, n, k, keep);
+        return;
+    default:
+        break;
+    }
+#endif
+    accelerate_scalar(h, v, stride, 0, n, k, keep);
+}
+
+
+void wave_move(double *h, const double *v, int n, double delta_t)
+{
+#ifdef KERNEL_X86
+    switch(get_kernel_level())
+    {
+    case KERNEL_AVX2:
+        move_avx2(h, v, n, delta_t);
+        return;
+    case KERNEL_SSE2:
+        move_sse2(h, v, n, delta_t);
+        return;
+    default:
+        break;
+    }
+#endif
+    move_scalar(h, v, 0, n, delta_t);
+}